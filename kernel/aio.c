@@ -0,0 +1,272 @@
+//
+// Asynchronous I/O rings.
+// aio_setup() maps a submission and a completion ring into the
+// process and starts a kernel worker for it.  The process queues
+// requests in the submission ring and calls aio_enter() once per
+// batch; the worker runs them in order against the process's files
+// and memory and posts one completion for each.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "vm.h"
+#include "aio.h"
+
+struct aioctx {
+	struct spinlock lock;
+	struct aio_ring *ring;  // Kernel address of the shared page
+	struct proc *owner;     // Process the requests run for
+	struct proc *worker;    // Kernel thread running them
+	int busy;               // Worker is running a request
+	int paused;             // Worker may not start new requests
+	int stop;               // Worker should exit
+};
+
+// Copy a NUL-terminated path from p's memory.
+static int
+fetchpath(struct proc *p, uint addr, char *buf)
+{
+	int i;
+
+	for(i = 0; i < MAXPATH && addr + i < p->sz; i++){
+		buf[i] = *(char*)(addr + i);
+		if(buf[i] == 0)
+			return 0;
+	}
+	return -1;
+}
+
+// Point the worker's cwd at p's current one, so that relative
+// paths follow any chdir() p made since aio_setup().
+static void
+aiocwd(struct proc *p)
+{
+	struct proc *w = myproc();
+	struct inode *ip;
+
+	acquire(&p->aio->lock);
+	ip = idup(p->cwd);
+	release(&p->aio->lock);
+	begin_op();
+	iput(w->cwd);
+	end_op();
+	w->cwd = ip;
+}
+
+// Run one request on behalf of p.  The worker borrows p's page
+// table, so user addresses can be used directly once checked.
+static int
+aiorun(struct proc *p, struct aio_sqe *sqe)
+{
+	struct file *f;
+	char path[MAXPATH];
+	int r;
+
+	switch(sqe->op){
+	case AIO_NOP:
+		return 0;
+
+	case AIO_READ:
+	case AIO_WRITE:
+		if(sqe->n < 0 || sqe->addr >= p->sz || sqe->n > p->sz - sqe->addr)
+			return -1;
+		if((f = fdget(p, sqe->fd)) == 0)
+			return -1;
+		if(sqe->op == AIO_READ)
+			r = fileread(f, (char*)sqe->addr, sqe->n);
+		else
+			r = filewrite(f, (char*)sqe->addr, sqe->n);
+		fileclose(f);
+		return r;
+
+	case AIO_OPEN:
+		if(fetchpath(p, sqe->addr, path) < 0)
+			return -1;
+		aiocwd(p);
+		if((f = fileopen(path, sqe->n)) == 0)
+			return -1;
+		if((r = fdinstall(p, f)) < 0)
+			fileclose(f);
+		return r;
+
+	case AIO_CLOSE:
+		if(sqe->fd < 0 || sqe->fd >= NOFILE)
+			return -1;
+		if((f = (struct file*)xchg((uint*)&p->ofile[sqe->fd], 0)) == 0)
+			return -1;
+		fileclose(f);
+		return 0;
+
+	case AIO_FSYNC:
+		// Requests run in order, so every earlier write is in
+		// the log; make sure its transaction has committed.
+		if((f = fdget(p, sqe->fd)) == 0)
+			return -1;
+		fileclose(f);
+		log_force();
+		return 0;
+	}
+	return -1;
+}
+
+static void
+aioworker(void *arg)
+{
+	struct aioctx *ctx = arg;
+	struct aio_ring *r = ctx->ring;
+	struct aio_sqe sqe;
+	struct aio_cqe *cqe;
+	int res;
+
+	acquire(&ctx->lock);
+	for(;;){
+		// Wait for a request, and for room to complete it.
+		while(!ctx->stop && (ctx->paused || r->sq_head == r->sq_tail ||
+		      r->cq_tail - r->cq_head >= AIO_CQSIZE))
+			sleep(ctx, &ctx->lock);
+		if(ctx->stop)
+			break;
+		__sync_synchronize();
+		sqe = r->sq[r->sq_head & (AIO_SQSIZE-1)];
+		r->sq_head++;
+		ctx->busy = 1;
+		release(&ctx->lock);
+
+		res = aiorun(ctx->owner, &sqe);
+
+		acquire(&ctx->lock);
+		cqe = &r->cq[r->cq_tail & (AIO_CQSIZE-1)];
+		cqe->user_data = sqe.user_data;
+		cqe->res = res;
+		__sync_synchronize();
+		r->cq_tail++;
+		ctx->busy = 0;
+		wakeup(&ctx->ring);
+	}
+	release(&ctx->lock);
+}
+
+// Map the rings into the current process and start its worker.
+// Returns the user address of the rings.
+int
+aiosetup(void)
+{
+	struct proc *p = myproc();
+	struct aioctx *ctx;
+	char *mem;
+	pte_t *pte;
+
+	if(p->aio)
+		return -1;
+	if((ctx = (struct aioctx*)kalloc()) == 0)
+		return -1;
+	if((mem = kalloczeroed()) == 0)
+		goto bad;
+	memset(ctx, 0, sizeof(*ctx));
+	initlock(&ctx->lock, "aio");
+	ctx->ring = (struct aio_ring*)mem;
+	ctx->owner = p;
+
+	// The page now belongs to the address space; freevm releases it.
+	if(mappages(p->pgdir, (char*)VIRT_AIO_RING, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+		kfree(mem);
+		goto bad;
+	}
+	if((ctx->worker = kthreadcreate(aioworker, ctx, "aio")) == 0){
+		pte = walkpgdir(p->pgdir, (char*)VIRT_AIO_RING, 0);
+		*pte = 0;
+		kfree(mem);
+		goto bad;
+	}
+	p->aio = ctx;
+	return VIRT_AIO_RING;
+
+bad:
+	kfree((char*)ctx);
+	return -1;
+}
+
+// Start the queued requests and wait until at least
+// min completions are ready.  Returns the number ready.
+int
+aioenter(int min)
+{
+	struct proc *p = myproc();
+	struct aioctx *ctx = p->aio;
+	struct aio_ring *r;
+	int n;
+
+	if(ctx == 0 || min < 0)
+		return -1;
+	if(min > AIO_CQSIZE)
+		min = AIO_CQSIZE;
+	r = ctx->ring;
+
+	acquire(&ctx->lock);
+	wakeup(ctx);
+	while((n = r->cq_tail - r->cq_head) < min){
+		if(p->killed){
+			release(&ctx->lock);
+			return -1;
+		}
+		sleep(&ctx->ring, &ctx->lock);
+	}
+	release(&ctx->lock);
+	return n;
+}
+
+// Hold p's worker off new requests and wait out the running one,
+// so that p can unmap memory a request might be using; or, if
+// !on, let it continue.  A request blocked on a pipe holds this up.
+void
+aiopause(struct proc *p, int on)
+{
+	struct aioctx *ctx = p->aio;
+
+	acquire(&ctx->lock);
+	if(on){
+		ctx->paused = 1;
+		while(ctx->busy)
+			sleep(&ctx->ring, &ctx->lock);
+	} else {
+		ctx->paused = 0;
+		wakeup(ctx);
+	}
+	release(&ctx->lock);
+}
+
+// Make ip the cwd of p, which has a worker, under the lock the
+// worker reads it with.  The caller drops the old cwd.
+void
+aiochdir(struct proc *p, struct inode *ip)
+{
+	acquire(&p->aio->lock);
+	p->cwd = ip;
+	release(&p->aio->lock);
+}
+
+// Stop p's worker and drop its rings.  Requests not yet started
+// are abandoned.  Called from exit and exec.
+void
+aiostop(struct proc *p)
+{
+	struct aioctx *ctx = p->aio;
+
+	acquire(&ctx->lock);
+	ctx->stop = 1;
+	wakeup(ctx);
+	release(&ctx->lock);
+
+	// Break the worker out of a pipe or console wait.
+	kill(ctx->worker->pid);
+	kthreadjoin(ctx->worker);
+
+	p->aio = 0;
+	kfree((char*)ctx);
+}
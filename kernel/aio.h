@@ -0,0 +1,44 @@
+#ifndef AIO_H
+#define AIO_H
+
+// Both the kernel and user programs use this header file.
+
+#define AIO_NOP    0
+#define AIO_READ   1  // read(fd, addr, n)
+#define AIO_WRITE  2  // write(fd, addr, n)
+#define AIO_OPEN   3  // open(addr, n); result is the new fd
+#define AIO_CLOSE  4  // close(fd)
+#define AIO_FSYNC  5  // completes once earlier writes are on disk
+
+#define AIO_SQSIZE  64  // submission ring entries (power of two)
+#define AIO_CQSIZE 128  // completion ring entries (power of two)
+
+// Submission queue entry.
+struct aio_sqe {
+	int op;          // AIO_*
+	int fd;
+	uint addr;       // buffer, or path for AIO_OPEN
+	int n;           // byte count, or omode for AIO_OPEN
+	uint user_data;  // handed back in the completion
+};
+
+// Completion queue entry.
+struct aio_cqe {
+	uint user_data;
+	int res;         // what the matching system call would return
+};
+
+// The page aio_setup() maps into the process.
+// The process fills sq[sq_tail] and consumes cq[cq_head];
+// the kernel consumes sq[sq_head] and fills cq[cq_tail].
+// Indices run freely and are masked by the ring size.
+struct aio_ring {
+	volatile uint sq_head;
+	volatile uint sq_tail;
+	volatile uint cq_head;
+	volatile uint cq_tail;
+	struct aio_sqe sq[AIO_SQSIZE];
+	struct aio_cqe cq[AIO_CQSIZE];
+};
+
+#endif
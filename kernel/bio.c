@@ -25,6 +25,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
 	struct spinlock lock;
@@ -41,6 +42,7 @@ binit(void)
 	struct buf *b;
 
 	initlock(&bcache.lock, "bcache");
+	tracklock(&bcache.lock);
 
 	// Create linked list of buffers
 	bcache.head.prev = &bcache.head;
@@ -69,6 +71,7 @@ bget(uint dev, uint blockno)
 		if(b->dev == dev && b->blockno == blockno){
 			b->refcnt++;
 			release(&bcache.lock);
+			traceevent(TR_BGETHIT, blockno, 0);
 			acquiresleep(&b->lock);
 			return b;
 		}
@@ -84,6 +87,7 @@ bget(uint dev, uint blockno)
 			b->flags = 0;
 			b->refcnt = 1;
 			release(&bcache.lock);
+			traceevent(TR_BGETMISS, blockno, 0);
 			acquiresleep(&b->lock);
 			return b;
 		}
@@ -14,6 +14,7 @@
 #include "mmu.h"
 #include "proc.h"
 #include "x86.h"
+#include "poll.h"
 
 void history_buff(char current_char, int eol_flag);
 extern int shift_flag;
@@ -48,6 +49,7 @@ static int panicked = 0;
 static struct {
 	struct spinlock lock;
 	int locking;
+	struct waitq pollq;  // processes in poll() on the console
 } cons;
 
 static void
@@ -219,7 +221,7 @@ void
 consoleintr(int (*getc)(void))
 {
 	static int flagh;
-	int c, doprocdump = 0;
+	int c, doprocdump = 0, dolockdump = 0;
 
 	acquire(&cons.lock);
 	while((c = getc()) >= 0){
@@ -229,6 +231,9 @@ consoleintr(int (*getc)(void))
 			// procdump() locks cons.lock indirectly; invoke later
 			doprocdump = 1;
 			break;
+		case C('T'):  // Lock contention statistics.
+			dolockdump = 1;
+			break;
 		case C('U'):  // Kill line.
 			while(input.e != input.w &&
 			      input.buf[(input.e-1) % INPUT_BUF] != '\n'){
@@ -257,6 +262,7 @@ consoleintr(int (*getc)(void))
 					}
 					input.w = input.e;
 					wakeup(&input.r);
+					waitqwakeup(&cons.pollq);
 				}
 			}
 			break;
@@ -267,6 +273,8 @@ consoleintr(int (*getc)(void))
 	if(doprocdump) {
 		procdump();  // now call procdump() wo. cons.lock held
 	}
+	if(dolockdump)
+		lockdump();
 }
 
 int
@@ -328,6 +336,25 @@ consolewrite(struct inode *ip, char *buf, int n)
 	return n;
 }
 
+// Input is ready once a whole line (or ^D) has been typed;
+// output never blocks.
+int
+consolepoll(struct inode *ip, int how)
+{
+	int r;
+
+	acquire(&cons.lock);
+	if(how == WQ_ADD)
+		waitqadd(&cons.pollq, myproc());
+	else if(how == WQ_DEL)
+		waitqdel(&cons.pollq, myproc());
+	r = POLLOUT;
+	if(input.r != input.w)
+		r |= POLLIN;
+	release(&cons.lock);
+	return r;
+}
+
 void
 consoleinit(void)
 {
@@ -335,6 +362,7 @@ consoleinit(void)
 
 	devsw[CONSOLE].write = consolewrite;
 	devsw[CONSOLE].read = consoleread;
+	devsw[CONSOLE].poll = consolepoll;
 	cons.locking = 1;
 
 	ioapicenable(IRQ_KBD, 0);
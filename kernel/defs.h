@@ -5,13 +5,28 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct memstat;
 struct pipe;
 struct proc;
+struct procmem;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
+struct waitq;
 struct superblock;
+struct timer;
+struct traceev;
+struct profsample;
+struct trapframe;
+struct sysstat;
+
+// aio.c
+int             aiosetup(void);
+int             aioenter(int);
+void            aiopause(struct proc*, int);
+void            aiostop(struct proc*);
+void            aiochdir(struct proc*, struct inode*);
 
 // bio.c
 void            binit(void);
@@ -32,10 +47,12 @@ int             exec(char*, char**);
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
+struct file*    filedupfd(struct file**, int);
 void            fileinit(void);
 int             fileread(struct file*, char*, int n);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
+int             filepoll(struct file*, int);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
@@ -45,8 +62,10 @@ struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
 void            ilock(struct inode*);
+void            ilockshared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
+void            iunlockshared(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
@@ -68,9 +87,27 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+char*           kalloccontig(int, uint);
+char*           kalloczeroed(void);
 void            kfree(char*);
+void            kfreecontig(char*, int);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kzeroinit(void);
+int             kzeroidle(void);
+void            kmemstat(struct memstat*);
+
+// kinfo.c
+void            kinfoinit(void);
+void            kinfotick(void);
+int             kinfomap(pde_t*, int);
+void            kinfounmap(pde_t*);
+
+// kmalloc.c
+void            kminit(void);
+void*           kmalloc(uint);
+void            kmfree(void*);
+int             kmpages(void);
 
 // kbd.c
 void            kbdintr(void);
@@ -82,6 +119,9 @@ extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
+void            lapicipi(int, int);
+void            lapictimer(uint64);
+extern uint     tickcycles;
 void            microdelay(int);
 
 // log.c
@@ -89,6 +129,7 @@ void            initlog(int dev);
 void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
+void            log_force(void);
 
 // mp.c
 extern int      ismp;
@@ -101,25 +142,47 @@ void            picinit(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, char*, int);
-int             pipewrite(struct pipe*, char*, int);
+int             pipepoll(struct pipe*, int, int);
+int             piperead(struct pipe*, char*, int, int);
+int             pipewrite(struct pipe*, char*, int, int);
+int             pipesplicein(struct pipe*, struct file*, int);
+int             pipespliceout(struct pipe*, struct file*, int);
+
+// prof.c
+void            profinit(void);
+void            profsample(struct trapframe*);
+void            profenable(int);
+int             profread(struct profsample*, int);
 
 // proc.c
 int             cpuid(void);
 void            exit(void);
 int             fork(void);
+int             futexwait(uint*, uint);
+void            futexwake(uint*);
 int             growproc(int);
 int             kill(int);
+struct proc*    kthreadcreate(void (*)(void*), void*, char*);
+void            kthreadexit(void) __attribute__((noreturn));
+void            kthreadjoin(struct proc*);
+struct proc*    swapgrab(struct proc*, int*);
+struct proc*    swaprelease(struct proc*);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
+void            pollsleep(struct timer*);
 void            procdump(void);
+int             procmem(struct procmem*, int);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
+void            setpgdir(struct proc*, pde_t*);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
+void            waitqadd(struct waitq*, struct proc*);
+void            waitqdel(struct waitq*, struct proc*);
+void            waitqwakeup(struct waitq*);
 void            wakeup(void*);
 void            yield(void);
 
@@ -132,15 +195,29 @@ void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
+void            tracklock(struct spinlock*);
+void            lockdump(void);
 void            pushcli(void);
 void            popcli(void);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// swap.c
+void            swapinit(void);
+int             swapout(int);
+int             swapfault(uint);
+int             swapinrange(uint, uint);
+void            swapcopy(pte_t, char*);
+void            swapfree(pte_t);
+void            swapstat(uint*, uint*);
+char*           kallocuser(int);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -149,6 +226,7 @@ char*           safestrcpy(char*, const char*, int);
 int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
+void            strbench(void);
 
 // syscall.c
 int             argint(int, int*);
@@ -157,12 +235,35 @@ int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
 void            syscall(void);
+int             sysstatread(struct sysstat*, int);
+void            sysstatreset(void);
+
+// sysfile.c
+struct file*    fdget(struct proc*, int);
+int             fdinstall(struct proc*, struct file*);
+struct file*    fileopen(char*, int);
 
 // timer.c
 void            timerinit(void);
+void            timerintr(void);
+void            timeridle(void);
+void            timerbusy(void);
+void            timeradd(struct timer*, uint64, void*);
+void            timerdel(struct timer*);
+uint64          tickdeadline(int);
+uint64          timedeadline(uint, uint);
+int             tsleep(uint64);
+
+// trace.c
+void            traceinit(void);
+void            traceevent(int, uint, uint);
+void            traceenable(int);
+int             traceread(struct traceev*, int);
 
 // trap.c
 void            idtinit(void);
+void            sysenterinit(void);
+extern int      sysenterok;
 extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
@@ -172,6 +273,10 @@ void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 
+// usercopy.S
+int             ucopy(void*, const void*, uint);
+int             ustrnlen(const char*, uint);
+
 // vm.c
 void            seginit(void);
 void            kvmalloc(void);
@@ -185,8 +290,14 @@ int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
+void            tlbflush(pde_t*, uint, uint);
+void            tlbdrop(pde_t*);
+void            tlbpoll(void);
+int             copyin(void*, uint, uint);
 int             copyout(pde_t*, uint, void*, uint);
+uint            extablefind(uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+void            vmusage(pde_t*, uint*, uint*, uint*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
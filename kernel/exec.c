@@ -26,7 +26,9 @@ exec(char *path, char **argv)
 		cprintf("exec: fail\n");
 		return -1;
 	}
-	ilock(ip);
+	// Loading only reads the executable, so concurrent execs
+	// of the same program can share its inode lock.
+	ilockshared(ip);
 	pgdir = 0;
 
 	// Check ELF header
@@ -57,7 +59,8 @@ exec(char *path, char **argv)
 		if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
 			goto bad;
 	}
-	iunlockput(ip);
+	iunlockshared(ip);
+	iput(ip);
 	end_op();
 	ip = 0;
 
@@ -68,6 +71,8 @@ exec(char *path, char **argv)
 		goto bad;
 	clearpteu(pgdir, (char*)(sz - 2*PGSIZE));
 	sp = sz;
+	if(kinfomap(pgdir, curproc->pid) < 0)
+		goto bad;
 
 	// Push argument strings, prepare rest of stack in ustack.
 	for(argc = 0; argv[argc]; argc++) {
@@ -95,8 +100,11 @@ exec(char *path, char **argv)
 	safestrcpy(curproc->name, last, sizeof(curproc->name));
 
 	// Commit to the user image.
+	// The aio worker runs on the old page table; retire it first.
+	if(curproc->aio)
+		aiostop(curproc);
 	oldpgdir = curproc->pgdir;
-	curproc->pgdir = pgdir;
+	setpgdir(curproc, pgdir);
 	curproc->sz = sz;
 	curproc->tf->eip = elf.entry;  // main
 	curproc->tf->esp = sp;
@@ -108,7 +116,8 @@ exec(char *path, char **argv)
 	if(pgdir)
 		freevm(pgdir);
 	if(ip){
-		iunlockput(ip);
+		iunlockshared(ip);
+		iput(ip);
 		end_op();
 	}
 	return -1;
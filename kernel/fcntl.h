@@ -8,5 +8,10 @@
 #define O_NOFOLLOW 0x004
 // O_nofollow does not collide with any other flags probably
 //something that would give true only when anded with itself
+#define O_NONBLOCK 0x800  // read/write return -1 instead of blocking
+
+// fcntl() commands
+#define F_GETFL   3  // return O_NONBLOCK if set
+#define F_SETFL   4  // set or clear O_NONBLOCK
 
 #endif
\ No newline at end of file
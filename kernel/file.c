@@ -5,22 +5,26 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "stat.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 // Declares an arrsy of devsw structs located in file.h, NDEV is the maximum major device number
 // This is basically an array of devices
 struct devsw devsw[NDEV];
+// Files are allocated with kmalloc() and freed when the last
+// reference goes away; ftable.lock protects every file's ref.
 struct {
 	struct spinlock lock;
-	struct file file[NFILE];
 } ftable;
 
 void
 fileinit(void)
 {
 	initlock(&ftable.lock, "ftable");
+	tracklock(&ftable.lock);
 }
 
 // Allocate a file structure.
@@ -29,16 +33,13 @@ filealloc(void)
 {
 	struct file *f;
 
-	acquire(&ftable.lock);
-	for(f = ftable.file; f < ftable.file + NFILE; f++){
-		if(f->ref == 0){
-			f->ref = 1;
-			release(&ftable.lock);
-			return f;
-		}
-	}
-	release(&ftable.lock);
-	return 0;
+	if((f = kmalloc(sizeof(*f))) == 0)
+		return 0;
+	memset(f, 0, sizeof(*f));
+	initsleeplock(&f->offlock, "fileoff");
+	f->type = FD_NONE;
+	f->ref = 1;
+	return f;
 }
 
 // Increment ref count for file f.
@@ -53,6 +54,21 @@ filedup(struct file *f)
 	return f;
 }
 
+// Increment ref count for whatever file sits in slot fd of an
+// ofile table.  Holding ftable.lock keeps a concurrent close of
+// the slot from dropping the last reference under us.
+struct file*
+filedupfd(struct file **ofile, int fd)
+{
+	struct file *f;
+
+	acquire(&ftable.lock);
+	if((f = ofile[fd]) != 0)
+		f->ref++;
+	release(&ftable.lock);
+	return f;
+}
+
 // Close file f.  (Decrement ref count, close when reaches 0.)
 void
 fileclose(struct file *f)
@@ -67,9 +83,8 @@ fileclose(struct file *f)
 		return;
 	}
 	ff = *f;
-	f->ref = 0;
-	f->type = FD_NONE;
 	release(&ftable.lock);
+	kmfree(f);
 
 	if(ff.type == FD_PIPE)
 		pipeclose(ff.pipe, ff.writable);
@@ -85,9 +100,9 @@ int
 filestat(struct file *f, struct stat *st)
 {
 	if(f->type == FD_INODE){
-		ilock(f->ip);
+		ilockshared(f->ip);
 		stati(f->ip, st);
-		iunlock(f->ip);
+		iunlockshared(f->ip);
 		return 0;
 	}
 	return -1;
@@ -102,12 +117,33 @@ fileread(struct file *f, char *addr, int n)
 	if(f->readable == 0)
 		return -1;
 	if(f->type == FD_PIPE)
-		return piperead(f->pipe, addr, n);
+		return piperead(f->pipe, addr, n, f->nonblock);
 	if(f->type == FD_INODE){
-		ilock(f->ip);
+		// Readers of a file share its inode lock, so processes
+		// reading through one shared descriptor are serialized
+		// on the descriptor's offset instead.  Writers hold the
+		// inode lock exclusively, which covers off for them.
+		acquiresleep(&f->offlock);
+		ilockshared(f->ip);
+		if(f->ip->type == T_DEV){
+			// Device drivers drop and retake the inode lock
+			// around blocking reads, which needs it exclusive.
+			iunlockshared(f->ip);
+			if(f->nonblock && !(filepoll(f, WQ_NONE) & POLLIN)){
+				releasesleep(&f->offlock);
+				return -1;
+			}
+			ilock(f->ip);
+			if((r = readi(f->ip, addr, f->off, n)) > 0)
+				f->off += r;
+			iunlock(f->ip);
+			releasesleep(&f->offlock);
+			return r;
+		}
 		if((r = readi(f->ip, addr, f->off, n)) > 0)
 			f->off += r;
-		iunlock(f->ip);
+		iunlockshared(f->ip);
+		releasesleep(&f->offlock);
 		return r;
 	}
 	panic("fileread");
@@ -122,7 +158,7 @@ filewrite(struct file *f, char *addr, int n)
 	if(f->writable == 0)
 		return -1;
 	if(f->type == FD_PIPE)
-		return pipewrite(f->pipe, addr, n);
+		return pipewrite(f->pipe, addr, n, f->nonblock);
 	if(f->type == FD_INODE){
 		// write a few blocks at a time to avoid exceeding
 		// the maximum log transaction size, including
@@ -155,3 +191,29 @@ filewrite(struct file *f, char *addr, int n)
 	panic("filewrite");
 }
 
+// Report which POLL* events are ready on f, and add or remove
+// the current process as a poller of the underlying object
+// (how is one of WQ_NONE, WQ_ADD, WQ_DEL).
+// Inodes other than devices are always ready.
+int
+filepoll(struct file *f, int how)
+{
+	struct inode *ip;
+	int r;
+
+	if(f->type == FD_PIPE)
+		return pipepoll(f->pipe, f->writable, how);
+	if(f->type != FD_INODE)
+		return POLLNVAL;
+	ip = f->ip;
+	if(ip->type == T_DEV && ip->major >= 0 && ip->major < NDEV &&
+	   devsw[ip->major].poll)
+		r = devsw[ip->major].poll(ip, how);
+	else
+		r = POLLIN | POLLOUT;
+	if(!f->readable)
+		r &= ~POLLIN;
+	if(!f->writable)
+		r &= ~POLLOUT;
+	return r;
+}
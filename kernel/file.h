@@ -6,8 +6,10 @@ struct file {
 	int ref; // reference count
 	char readable;
 	char writable;
+	char nonblock;  // O_NONBLOCK
 	struct pipe *pipe;
 	struct inode *ip;
+	struct sleeplock offlock;  // serializes reads that use off
 	uint off;
 };
 // ==================================IMPORTANT====================================================
@@ -30,6 +32,7 @@ struct inode {
 	uint size;			// Number of bytes for the file, in case of symlinks only the path length
 						// more exaustive info can be found in the link below
 	uint addrs[NDIRECT+1];	// adress for the file data, ndirect is 12 blocks
+	struct inode *next;	// icache list, protected by icache.lock
 };
 
 // table mapping major device number to
@@ -38,8 +41,16 @@ struct devsw {
 	// unassigned function pointers
 	int (*read)(struct inode*, char*, int);
 	int (*write)(struct inode*, char*, int);
+	// Return ready POLL* events; register or unregister the
+	// caller for wakeups as directed by the WQ_* argument.
+	int (*poll)(struct inode*, int);
 };
 
+// How filepoll() and friends treat the caller's waitq entry.
+#define WQ_NONE 0
+#define WQ_ADD  1
+#define WQ_DEL  2
+
 extern struct devsw devsw[];
 
 #define CONSOLE 1
@@ -52,22 +52,35 @@ bzero(int dev, int bno)
 
 // Blocks.
 
+// Bitmap block where balloc() last found a free block.  Searches
+// start there, so a large disk does not rescan its full bitmap
+// blocks on every allocation.  Only a hint; the bitmap block's
+// buffer lock is what serializes allocation.
+static uint bhint;
+
 // Allocate a zeroed disk block.
 static uint
 balloc(uint dev)
 {
-	int b, bi, m;
+	uint b, bi, n, nbmap;
+	int m;
 	struct buf *bp;
 
-	bp = 0;
-	for(b = 0; b < sb.size; b += BPB){
+	nbmap = (sb.size + BPB - 1) / BPB;
+	for(n = 0; n < nbmap; n++){
+		b = ((bhint + n) % nbmap) * BPB;
 		bp = bread(dev, BBLOCK(b, sb));
 		for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
+			if(bi % 8 == 0 && bp->data[bi/8] == 0xff){
+				bi += 7;  // Whole byte in use.
+				continue;
+			}
 			m = 1 << (bi % 8);
 			if((bp->data[bi/8] & m) == 0){  // Is block free?
 				bp->data[bi/8] |= m;  // Mark block in use.
 				log_write(bp);
 				brelse(bp);
+				bhint = b / BPB;
 				bzero(dev, b + bi);
 				return b + bi;
 			}
@@ -119,18 +132,17 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in cache: ip->ref tracks the number of
+//   in-memory pointers to a cache entry (open files and
+//   current directories). iget() finds or kmalloc()s an
+//   entry and increments its ref; iput() decrements ref
+//   and frees the entry when it reaches zero.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   the disk and sets ip->valid; a new entry from iget()
+//   starts out invalid.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -154,35 +166,40 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
+// The icache.lock spin-lock protects the list of icache
+// entries. Since ip->ref decides when an entry is freed,
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold icache.lock while using any of those fields.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+// Code that only reads an inode and its content may instead
+// hold ip->lock shared with ilockshared(), so that concurrent
+// readers of one file or directory do not serialize.
 
 struct {
 	struct spinlock lock;
-	struct inode inode[NINODE];
+	struct inode *list;  // every referenced inode
 } icache;
 
 void
 iinit(int dev)
 {
-	int i = 0;
-
 	initlock(&icache.lock, "icache");
-	for(i = 0; i < NINODE; i++) {
-		initsleeplock(&icache.inode[i].lock, "inode");
-	}
+	tracklock(&icache.lock);
 
 	readsb(dev, &sb);
 	cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
 		sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
 		sb.bmapstart);
+	// The layout comes from mkfs; make sure it hangs together.
+	if(sb.nblocks > sb.size || sb.ninodes == 0 ||
+	   IBLOCK(sb.ninodes - 1, sb) >= sb.bmapstart ||
+	   BBLOCK(sb.size - 1, sb) >= sb.size - sb.nblocks)
+		panic("iinit: bad superblock");
+	bhint = 0;
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -240,31 +257,41 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-	struct inode *ip, *empty;
+	struct inode *ip, *new;
 
+	new = 0;
 	acquire(&icache.lock);
-
-	// Is the inode already cached?
-	empty = 0;
-	for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-		if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-			ip->ref++;
-			release(&icache.lock);
-			return ip;
+	for(;;){
+		// Is the inode already cached?
+		for(ip = icache.list; ip; ip = ip->next){
+			if(ip->dev == dev && ip->inum == inum){
+				ip->ref++;
+				release(&icache.lock);
+				if(new)
+					kmfree(new);
+				return ip;
+			}
 		}
-		if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-			empty = ip;
-	}
+		if(new)
+			break;
 
-	// Recycle an inode cache entry.
-	if(empty == 0)
-		panic("iget: no inodes");
+		// Allocate an entry without the lock held, then look
+		// again in case somebody else added the inode meanwhile.
+		release(&icache.lock);
+		if((new = kmalloc(sizeof(*new))) == 0)
+			panic("iget: no inodes");
+		memset(new, 0, sizeof(*new));
+		initsleeplock(&new->lock, "inode");
+		acquire(&icache.lock);
+	}
 
-	ip = empty;
+	ip = new;
 	ip->dev = dev;
 	ip->inum = inum;
 	ip->ref = 1;
 	ip->valid = 0;
+	ip->next = icache.list;
+	icache.list = ip;
 	release(&icache.lock);
 
 	return ip;
@@ -323,9 +350,39 @@ iunlock(struct inode *ip)
 	releasesleep(&ip->lock);
 }
 
+// Lock the given inode for reading only.
+// The caller may examine ip->xxx and call readi(), but not
+// modify anything. Reads the inode from disk if necessary.
+void
+ilockshared(struct inode *ip)
+{
+	if(ip == 0 || ip->ref < 1)
+		panic("ilockshared");
+
+	acquiresleepshared(&ip->lock);
+	if(ip->valid == 0){
+		// Loading modifies the inode; do it under the
+		// exclusive lock. Our reference keeps it valid after.
+		releasesleepshared(&ip->lock);
+		ilock(ip);
+		iunlock(ip);
+		acquiresleepshared(&ip->lock);
+	}
+}
+
+// Unlock an inode locked with ilockshared().
+void
+iunlockshared(struct inode *ip)
+{
+	if(ip == 0 || ip->ref < 1)
+		panic("iunlockshared");
+
+	releasesleepshared(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, the inode cache entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -333,6 +390,8 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+	struct inode **pp;
+
 	acquiresleep(&ip->lock);
 	if(ip->valid && ip->nlink == 0){
 		acquire(&icache.lock);
@@ -349,8 +408,15 @@ iput(struct inode *ip)
 	releasesleep(&ip->lock);
 
 	acquire(&icache.lock);
-	ip->ref--;
+	if(--ip->ref > 0){
+		release(&icache.lock);
+		return;
+	}
+	for(pp = &icache.list; *pp != ip; pp = &(*pp)->next)
+		;
+	*pp = ip->next;
 	release(&icache.lock);
+	kmfree(ip);
 }
 
 // Common idiom: unlock, then put.
@@ -709,18 +775,19 @@ namex(char *path, int nameiparent, char *name)
 		// see skipelem for more examples.
 		
 		//cprintf("this ilock seems to get me");
-		ilock(ip);
+		ilockshared(ip);
 		//cprintf("AM I STILL ALIVE\n");
 		if(ip->type != T_DIR){
 			//cprintf("Maybe I fail because i am not a directoty\n");
-			iunlockput(ip);
+			iunlockshared(ip);
+			iput(ip);
 			return 0;
 			//ERROR, cannot not be directory
 		}
 		if(nameiparent && *path == '\0'){
 			// Stop one level early.
 			//cprintf("Maybe i get to nameiparent\n");
-			iunlock(ip);
+			iunlockshared(ip);
 			return ip;
 		}
 		//cprintf("Do i reach here\n");
@@ -729,11 +796,13 @@ namex(char *path, int nameiparent, char *name)
 		// If next == 0, that means that there were no dirents matching the name
 		// and the procces is terminated, hence retutn 0 
 		if((next = dirlookup(ip, name, 0)) == 0){
-			iunlockput(ip);
+			iunlockshared(ip);
+			iput(ip);
 			return 0;
 			//ERROR
 		}
-		iunlockput(ip);
+		iunlockshared(ip);
+		iput(ip);
 		ip = next;
 		//cprintf("Im i stuck here?\n");
 	}
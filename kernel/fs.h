@@ -8,7 +8,7 @@
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
-//                                          free bit map | data blocks]
+//                                  free bit map | data blocks | swap]
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -20,6 +20,8 @@ struct superblock {
 	uint logstart;     // Block number of first log block
 	uint inodestart;   // Block number of first inode block
 	uint bmapstart;    // Block number of first free map block
+	uint swapstart;    // Block number of first swap block
+	uint nswap;        // Number of swap blocks
 };
 
 #define NDIRECT 12
@@ -46,7 +48,7 @@ struct dinode {
 #define BPB           (BSIZE*8)
 
 // Block of free map containing bit for block b
-#define BBLOCK(b, sb) (b/BPB + sb.bmapstart)
+#define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
 
 // Directory is a file containing a sequence of dirent structures.
 #define DIRSIZ 14
@@ -0,0 +1,9 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+// Both the kernel and user programs use this header file.
+
+#define FUTEX_WAIT 0  // sleep if *addr == val, until a FUTEX_WAKE on addr
+#define FUTEX_WAKE 1  // wake every process waiting on addr
+
+#endif
@@ -12,6 +12,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 #define SECTOR_SIZE   512
 #define IDE_BSY       0x80
@@ -75,15 +76,18 @@ idestart(struct buf *b)
 {
 	if(b == 0)
 		panic("idestart");
-	if(b->blockno >= FSSIZE)
-		panic("incorrect blockno");
 	int sector_per_block =  BSIZE/SECTOR_SIZE;
 	int sector = b->blockno * sector_per_block;
+	// The disk's size is whatever mkfs made it (see the superblock);
+	// the only hard limit is 28-bit LBA addressing.
+	if(b->blockno >= (1 << 28) / sector_per_block)
+		panic("incorrect blockno");
 	int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
 	int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
 	if (sector_per_block > 7) panic("idestart");
 
+	traceevent(TR_DISKSTART, b->blockno, (b->flags & B_DIRTY) != 0);
 	idewait(0);
 	outb(0x3f6, 0);  // generate interrupt
 	outb(0x1f2, sector_per_block);  // number of sectors
@@ -113,6 +117,7 @@ ideintr(void)
 		return;
 	}
 	idequeue = b->qnext;
+	traceevent(TR_DISKDONE, b->blockno, 0);
 
 	// Read data if needed.
 	if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
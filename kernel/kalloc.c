@@ -1,6 +1,11 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, and contiguous
+// runs of them for 4 MiB user pages.
+//
+// A kernel thread keeps a pool of pages that are already zeroed,
+// filling it while CPUs would otherwise halt, so that callers of
+// kalloczeroed() do not pay for the memset.
 
 #include "types.h"
 #include "defs.h"
@@ -8,6 +13,9 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "spinlock.h"
+#include "x86.h"
+#include "proc.h"
+#include "memstat.h"
 
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
@@ -15,14 +23,40 @@ extern char end[]; // first address after kernel loaded from ELF file
 
 struct run {
 	struct run *next;
+	struct run *prev;
 };
 
+// The free list is doubly linked, and freemap has a bit set for
+// every page on it, so that kalloccontig() can find a free
+// physical range and pull its pages out of the middle of the list.
+#define NPFN (PHYSTOP/PGSIZE)
+#define PFN(v) (V2P(v)/PGSIZE)
+
 struct {
 	struct spinlock lock;
 	int use_lock;
 	struct run *freelist;
+	uint freemap[NPFN/32];
+	struct run *zerolist;  // pages known to hold only zeros
+	int nzero;             // pages on zerolist
+	int zeroing;           // kzeroer is awake
+	uint npages;           // pages handed to the allocator
+	uint nfree;            // pages on freelist
 } kmem;
 
+static void
+unlink(struct run *r)
+{
+	if(r->prev)
+		r->prev->next = r->next;
+	else
+		kmem.freelist = r->next;
+	if(r->next)
+		r->next->prev = r->prev;
+	kmem.freemap[PFN(r)/32] &= ~(1 << (PFN(r)%32));
+	kmem.nfree--;
+}
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -41,6 +75,7 @@ kinit2(void *vstart, void *vend)
 {
 	freerange(vstart, vend);
 	kmem.use_lock = 1;
+	tracklock(&kmem.lock);
 }
 
 void
@@ -48,8 +83,10 @@ freerange(void *vstart, void *vend)
 {
 	char *p;
 	p = (char*)PGROUNDUP((uint)vstart);
-	for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
+	for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
 		kfree(p);
+		kmem.npages++;
+	}
 }
 
 // Free the page of physical memory pointed at by v,
@@ -64,14 +101,21 @@ kfree(char *v)
 	if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
 		panic("kfree");
 
+#ifndef NOJUNK
 	// Fill with junk to catch dangling refs.
 	memset(v, 1, PGSIZE);
+#endif
 
 	if(kmem.use_lock)
 		acquire(&kmem.lock);
 	r = (struct run*)v;
+	r->prev = 0;
 	r->next = kmem.freelist;
+	if(r->next)
+		r->next->prev = r;
 	kmem.freelist = r;
+	kmem.freemap[PFN(r)/32] |= 1 << (PFN(r)%32);
+	kmem.nfree++;
 	if(kmem.use_lock)
 		release(&kmem.lock);
 }
@@ -88,9 +132,172 @@ kalloc(void)
 		acquire(&kmem.lock);
 	r = kmem.freelist;
 	if(r)
-		kmem.freelist = r->next;
+		unlink(r);
+	else if((r = kmem.zerolist) != 0){
+		kmem.zerolist = r->next;
+		kmem.nzero--;
+	}
+	if(kmem.use_lock)
+		release(&kmem.lock);
+	return (char*)r;
+}
+
+// Allocate one page filled with zeros, from the pre-zeroed pool
+// when it has any.  Returns 0 if the memory cannot be allocated.
+char*
+kalloczeroed(void)
+{
+	struct run *r;
+
+	if(kmem.use_lock)
+		acquire(&kmem.lock);
+	if((r = kmem.zerolist) != 0){
+		kmem.zerolist = r->next;
+		kmem.nzero--;
+	}
 	if(kmem.use_lock)
 		release(&kmem.lock);
+	if(r){
+		r->next = 0;
+		return (char*)r;
+	}
+	if((r = (struct run*)kalloc()) != 0)
+		memset(r, 0, PGSIZE);
 	return (char*)r;
 }
 
+// Give the pre-zeroed pool back to the free list, so that
+// kalloccontig() can see those pages.  Caller holds kmem.lock.
+static void
+zerodrain(void)
+{
+	struct run *r;
+
+	while((r = kmem.zerolist) != 0){
+		kmem.zerolist = r->next;
+		kmem.nzero--;
+		r->prev = 0;
+		r->next = kmem.freelist;
+		if(r->next)
+			r->next->prev = r;
+		kmem.freelist = r;
+		kmem.freemap[PFN(r)/32] |= 1 << (PFN(r)%32);
+		kmem.nfree++;
+	}
+}
+
+// Zero free pages into the pool until it holds NZEROPAGES, then
+// sleep until kzeroidle() finds an idle CPU and a short pool.
+static void
+kzeroer(void *arg)
+{
+	struct run *r;
+
+	for(;;){
+		acquire(&kmem.lock);
+		while(kmem.nzero >= NZEROPAGES || kmem.freelist == 0){
+			kmem.zeroing = 0;
+			sleep(&kmem.zerolist, &kmem.lock);
+		}
+		r = kmem.freelist;
+		unlink(r);
+		release(&kmem.lock);
+
+		memset(r, 0, PGSIZE);
+
+		acquire(&kmem.lock);
+		r->next = kmem.zerolist;
+		kmem.zerolist = r;
+		kmem.nzero++;
+		release(&kmem.lock);
+
+		// Let real work have the CPU back.
+		yield();
+	}
+}
+
+void
+kzeroinit(void)
+{
+	kmem.zeroing = 1;
+	if(kthreadcreate(kzeroer, 0, "kzero") == 0)
+		panic("kzeroinit");
+}
+
+// Called by the scheduler when it has nothing to run.  Wake the
+// zeroing thread if the pool is short; return 1 if it was woken,
+// so the CPU runs it instead of halting.  Reads without the lock
+// are only a hint; kzeroer rechecks.
+int
+kzeroidle(void)
+{
+	if(kmem.zeroing || kmem.nzero >= NZEROPAGES || kmem.freelist == 0)
+		return 0;
+	acquire(&kmem.lock);
+	kmem.zeroing = 1;
+	wakeup(&kmem.zerolist);
+	release(&kmem.lock);
+	return 1;
+}
+
+// Allocate npages physically contiguous pages, the first aligned
+// to align bytes (a multiple of PGSIZE).  Scans the free bitmap,
+// so it is much slower than kalloc().  Returns 0 if no such range
+// is free.  The pages can be freed one by one with kfree().
+char*
+kalloccontig(int npages, uint align)
+{
+	uint pfn, step, i;
+	int drained;
+
+	step = align / PGSIZE;
+	if(npages <= 0 || step == 0)
+		return 0;
+	drained = 0;
+	if(kmem.use_lock)
+		acquire(&kmem.lock);
+again:
+	for(pfn = 0; pfn + npages <= NPFN; pfn += step){
+		for(i = 0; i < npages; i++)
+			if((kmem.freemap[(pfn+i)/32] & (1 << ((pfn+i)%32))) == 0)
+				break;
+		if(i == npages){
+			for(i = 0; i < npages; i++)
+				unlink((struct run*)P2V((pfn+i)*PGSIZE));
+			if(kmem.use_lock)
+				release(&kmem.lock);
+			return P2V(pfn*PGSIZE);
+		}
+		// No range can start at or before the busy page.
+		pfn = (pfn + i) / step * step;
+	}
+	if(!drained && kmem.nzero > 0){
+		zerodrain();
+		drained = 1;
+		goto again;
+	}
+	if(kmem.use_lock)
+		release(&kmem.lock);
+	return 0;
+}
+
+// Fill in the page counts of ms.
+void
+kmemstat(struct memstat *ms)
+{
+	acquire(&kmem.lock);
+	ms->total = kmem.npages;
+	ms->free = kmem.nfree + kmem.nzero;
+	ms->zeroed = kmem.nzero;
+	release(&kmem.lock);
+}
+
+void
+kfreecontig(char *v, int npages)
+{
+	int i;
+
+	for(i = 0; i < npages; i++)
+		kfree(v + i*PGSIZE);
+}
+
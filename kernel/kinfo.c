@@ -0,0 +1,64 @@
+// Kernel info pages.
+//
+// Every process has two read-only pages mapped just below the aio
+// ring: one kinfo page shared by all of them, which the timer
+// interrupt keeps current, and a pinfo page of its own.  ulib reads
+// them for uptime(), getpid() and the TSC clock, so timing loops in
+// user code need no system call.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "vm.h"
+#include "kinfo.h"
+
+static struct kinfo *kinfo;
+
+void
+kinfoinit(void)
+{
+	if((kinfo = (struct kinfo*)kalloczeroed()) == 0)
+		panic("kinfoinit");
+	kinfo->ncpu = ncpu;
+	kinfo->tscboot = rdtsc();
+	kinfo->tscpertick = tickcycles;
+}
+
+// Called when ticks advances, with tickslock held.
+void
+kinfotick(void)
+{
+	kinfo->ticks = ticks;
+}
+
+// Map the info pages into a new address space for process pid.
+// The pinfo page then belongs to pgdir and freevm() frees it.
+int
+kinfomap(pde_t *pgdir, int pid)
+{
+	char *mem;
+
+	if((mem = kalloczeroed()) == 0)
+		return -1;
+	((struct pinfo*)mem)->pid = pid;
+	if(mappages(pgdir, (char*)VIRT_PINFO, PGSIZE, V2P(mem), PTE_U) < 0){
+		kfree(mem);
+		return -1;
+	}
+	return mappages(pgdir, (char*)VIRT_KINFO, PGSIZE, V2P(kinfo), PTE_U);
+}
+
+// Take the shared page out of pgdir so that freeing the user
+// memory leaves it alone.
+void
+kinfounmap(pde_t *pgdir)
+{
+	pte_t *pte;
+
+	if((pte = walkpgdir(pgdir, (char*)VIRT_KINFO, 0)) != 0)
+		*pte = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef KINFO_H
+#define KINFO_H
+
+// The kernel info pages, mapped read-only into every process so
+// that user code can read the time and its pid without a system
+// call (see kinfo.c).  Both the kernel and user programs use this
+// header file.
+
+// At VIRT_KINFO, shared by all processes.
+struct kinfo {
+	volatile uint ticks;       // timer interrupts since boot, as uptime()
+	uint tscpertick;           // TSC cycles per tick
+	uint ncpu;                 // processors running
+	uint pad;
+	uint64 tscboot;            // TSC at boot
+};
+
+// At VIRT_KINFO + PAGESIZE, one per process.
+struct pinfo {
+	int pid;
+};
+
+#endif
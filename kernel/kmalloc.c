@@ -0,0 +1,236 @@
+// Small-object allocator for kernel data structures.
+//
+// Requests of up to KMMAX bytes are rounded up to a power-of-two
+// size class and carved out of slabs: kalloc()'d pages that start
+// with a struct slab header and hold objects of one class.  Larger
+// requests, up to a page, get a whole page from kalloc().  Slab
+// objects are never page aligned, which is how kmfree() tells the
+// two apart.
+//
+// Each CPU keeps a magazine of free objects per class, so most
+// kmalloc()/kmfree() pairs never touch a shared lock.  An empty
+// magazine is refilled, and a full one half flushed, under the
+// class's cache lock.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+#define KMMIN     16    // smallest size class
+#define KMMAX     1024  // largest size class
+#define NKMCLASS  7     // 16, 32, ..., 1024
+#define MAGSIZE   16    // objects per per-CPU magazine
+
+struct kmcache;
+
+struct slab {
+	struct kmcache *cache;
+	struct slab *next;   // on the cache's partial list
+	struct slab *prev;
+	void *free;          // chain of free objects in this slab
+	int nfree;
+};
+
+#define SLABHDR ((sizeof(struct slab) + KMMIN - 1) & ~(KMMIN - 1))
+
+struct kmcache {
+	struct spinlock lock;
+	uint size;           // object size
+	int perslab;         // objects per slab
+	struct slab *partial;  // slabs with at least one free object
+	int nslabs;          // slab pages held
+	int nalloc;          // objects handed out, magazines excluded
+};
+
+struct magazine {
+	int n;
+	void *obj[MAGSIZE];
+};
+
+static struct kmcache caches[NKMCLASS];
+static struct magazine mags[NCPU][NKMCLASS];
+
+void
+kminit(void)
+{
+	struct kmcache *c;
+	int i;
+
+	for(i = 0; i < NKMCLASS; i++){
+		c = &caches[i];
+		initlock(&c->lock, "kmcache");
+		c->size = KMMIN << i;
+		c->perslab = (PGSIZE - SLABHDR) / c->size;
+	}
+}
+
+static int
+kmclass(uint n)
+{
+	int i;
+
+	for(i = 0; (KMMIN << i) < n; i++)
+		;
+	return i;
+}
+
+static void
+unlinkslab(struct kmcache *c, struct slab *s)
+{
+	if(s->prev)
+		s->prev->next = s->next;
+	else
+		c->partial = s->next;
+	if(s->next)
+		s->next->prev = s->prev;
+}
+
+static void
+pushslab(struct kmcache *c, struct slab *s)
+{
+	s->prev = 0;
+	s->next = c->partial;
+	if(s->next)
+		s->next->prev = s;
+	c->partial = s;
+}
+
+// Carve a fresh page into a slab.  Caller holds c->lock.
+static struct slab*
+kmgrow(struct kmcache *c)
+{
+	struct slab *s;
+	char *obj;
+	int i;
+
+	if((s = (struct slab*)kalloc()) == 0)
+		return 0;
+	s->cache = c;
+	s->free = 0;
+	s->nfree = 0;
+	obj = (char*)s + SLABHDR;
+	for(i = 0; i < c->perslab; i++, obj += c->size){
+		*(void**)obj = s->free;
+		s->free = obj;
+		s->nfree++;
+	}
+	pushslab(c, s);
+	c->nslabs++;
+	return s;
+}
+
+// Move objects from c's slabs into m until it is half full.
+static void
+kmrefill(struct kmcache *c, struct magazine *m)
+{
+	struct slab *s;
+	void *v;
+
+	acquire(&c->lock);
+	while(m->n < MAGSIZE/2){
+		if((s = c->partial) == 0 && (s = kmgrow(c)) == 0)
+			break;
+		v = s->free;
+		s->free = *(void**)v;
+		if(--s->nfree == 0)
+			unlinkslab(c, s);
+		m->obj[m->n++] = v;
+		c->nalloc++;
+	}
+	release(&c->lock);
+}
+
+// Return the n oldest objects in m to their slabs.  A slab that
+// becomes entirely free goes back to kalloc() unless it is the
+// cache's only partial slab.
+static void
+kmflush(struct kmcache *c, struct magazine *m, int n)
+{
+	struct slab *s;
+	void *v;
+	int i;
+
+	acquire(&c->lock);
+	for(i = 0; i < n; i++){
+		v = m->obj[i];
+		s = (struct slab*)PGROUNDDOWN((uint)v);
+		*(void**)v = s->free;
+		s->free = v;
+		if(s->nfree++ == 0)
+			pushslab(c, s);
+		c->nalloc--;
+		if(s->nfree == c->perslab && (s->prev || s->next)){
+			unlinkslab(c, s);
+			c->nslabs--;
+			kfree((char*)s);
+		}
+	}
+	release(&c->lock);
+	memmove(m->obj, m->obj + n, (m->n - n) * sizeof(m->obj[0]));
+	m->n -= n;
+}
+
+// Pages held by slabs, for memstat().  Objects in magazines
+// count as allocated.
+int
+kmpages(void)
+{
+	int i, n;
+
+	n = 0;
+	for(i = 0; i < NKMCLASS; i++){
+		acquire(&caches[i].lock);
+		n += caches[i].nslabs;
+		release(&caches[i].lock);
+	}
+	return n;
+}
+
+// Allocate n bytes, at most a page.  The memory is not zeroed.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmalloc(uint n)
+{
+	struct magazine *m;
+	int i;
+	void *v;
+
+	if(n == 0 || n > PGSIZE)
+		return 0;
+	if(n > KMMAX)
+		return kalloc();
+	i = kmclass(n);
+	pushcli();
+	m = &mags[cpuid()][i];
+	if(m->n == 0)
+		kmrefill(&caches[i], m);
+	v = m->n > 0 ? m->obj[--m->n] : 0;
+	popcli();
+	return v;
+}
+
+void
+kmfree(void *v)
+{
+	struct magazine *m;
+	struct slab *s;
+	int i;
+
+	if((uint)v % PGSIZE == 0){
+		kfree(v);
+		return;
+	}
+	s = (struct slab*)PGROUNDDOWN((uint)v);
+	i = s->cache - caches;
+	if(i < 0 || i >= NKMCLASS)
+		panic("kmfree");
+	pushcli();
+	m = &mags[cpuid()][i];
+	if(m->n == MAGSIZE)
+		kmflush(&caches[i], m, MAGSIZE/2);
+	m->obj[m->n++] = v;
+	popcli();
+}
@@ -31,7 +31,7 @@
 #define ICRHI   (0x0310/4)   // Interrupt Command [63:32]
 #define TIMER   (0x0320/4)   // Local Vector Table 0 (TIMER)
 	#define X1         0x0000000B   // divide counts by 1
-	#define PERIODIC   0x00020000   // Periodic
+	#define PERIODIC   0x00020000   // Periodic (else one-shot)
 #define PCINT   (0x0340/4)   // Performance Counter LVT
 #define LINT0   (0x0350/4)   // Local Vector Table 1 (LINT0)
 #define LINT1   (0x0360/4)   // Local Vector Table 2 (LINT1)
@@ -43,6 +43,15 @@
 
 volatile uint *lapic;  // Initialized in mp.c
 
+// PIT channel 2, the reference for calibrating the LAPIC timer.
+#define PIT_HZ    1193182
+#define PIT_CH2   0x42
+#define PIT_MODE  0x43
+#define PIT_GATE  0x61      // bit 0 gates channel 2; bit 5 is its output
+
+uint tickcycles;         // TSC cycles per clock tick
+static uint timermul;    // LAPIC timer counts per TSC cycle, 16.16 fixed point
+
 static void
 lapicw(int index, int value)
 {
@@ -50,6 +59,44 @@ lapicw(int index, int value)
 	lapic[ID];  // wait for write to finish, by reading
 }
 
+// Time one clock tick with PIT channel 2, counting TSC cycles
+// and LAPIC timer counts over it.
+static void
+lapiccalibrate(void)
+{
+	uint count, n, spins;
+	uint64 t0, t1;
+	uchar gate;
+
+	lapicw(TDCR, X1);
+	lapicw(TIMER, MASKED);
+	count = PIT_HZ / HZ;
+	gate = inb(PIT_GATE);
+	outb(PIT_GATE, (gate & ~0x02) | 0x01);  // gate on, speaker off
+	outb(PIT_MODE, 0xB0);  // channel 2, low then high byte, mode 0
+	outb(PIT_CH2, count & 0xFF);
+	lapicw(TICR, 0xFFFFFFFF);
+	t0 = rdtsc();
+	outb(PIT_CH2, count >> 8);  // starts the count
+	for(spins = 0; !(inb(PIT_GATE) & 0x20) && spins < 100000000; spins++)
+		;
+	t1 = rdtsc();
+	n = 0xFFFFFFFF - lapic[TCCR];
+	outb(PIT_GATE, gate);
+	if(spins == 100000000){
+		// No PIT: fall back to a tick of 10^7 LAPIC counts.
+		n = 10000000;
+		lapicw(TICR, n);
+		t0 = rdtsc();
+		while(lapic[TCCR] != 0)
+			;
+		t1 = rdtsc();
+	}
+	lapicw(TICR, 0);
+	tickcycles = t1 - t0;
+	timermul = divl((uint64)n << 16, tickcycles);
+}
+
 void
 lapicinit(void)
 {
@@ -59,13 +106,15 @@ lapicinit(void)
 	// Enable local APIC; set spurious interrupt vector.
 	lapicw(SVR, ENABLE | (T_IRQ0 + IRQ_SPURIOUS));
 
-	// The timer repeatedly counts down at bus frequency
-	// from lapic[TICR] and then issues an interrupt.
-	// If xv6 cared more about precise timekeeping,
-	// TICR would be calibrated using an external time source.
+	// The timer counts down at bus frequency from lapic[TICR]
+	// and then issues an interrupt, once: timerarm() sets the
+	// next deadline each time.  The bus frequency is the same
+	// on every CPU, so the boot CPU measures it for all.
+	if(tickcycles == 0)
+		lapiccalibrate();
 	lapicw(TDCR, X1);
-	lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
-	lapicw(TICR, 10000000);
+	lapicw(TIMER, T_IRQ0 + IRQ_TIMER);
+	lapicw(TICR, 0);
 
 	// Disable logical interrupt lines.
 	lapicw(LINT0, MASKED);
@@ -112,16 +161,47 @@ lapiceoi(void)
 		lapicw(EOI, 0);
 }
 
+// Interrupt this CPU once, about cycles TSC cycles from now,
+// or never if cycles is 0.  Waits of over a second are cut
+// short; the interrupt handler then just sets the timer again.
+void
+lapictimer(uint64 cycles)
+{
+	uint64 n;
+
+	if(!lapic)
+		return;
+	if(cycles > (uint64)HZ * tickcycles)
+		cycles = (uint64)HZ * tickcycles;
+	// Round up, so the interrupt does not come early.
+	n = cycles ? ((cycles * timermul) >> 16) + 1 : 0;
+	lapicw(TICR, n);
+}
+
 // Spin for a given number of microseconds.
-// On real hardware would want to tune this dynamically.
 void
 microdelay(int us)
 {
+	uint64 end;
+
+	end = rdtsc() + (uint64)us * (tickcycles / (1000000 / HZ));
+	while(rdtsc() < end)
+		;
 }
 
 #define CMOS_PORT    0x70
 #define CMOS_RETURN  0x71
 
+// Send interrupt vector vec to the CPU with local APIC id apicid.
+void
+lapicipi(int apicid, int vec)
+{
+	lapicw(ICRHI, apicid<<24);
+	lapicw(ICRLO, FIXED | ASSERT | vec);
+	while(lapic[ICRLO] & DELIVS)
+		;
+}
+
 // Start additional processor running entry code at addr.
 // See Appendix B of MultiProcessor Specification.
 void
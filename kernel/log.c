@@ -5,6 +5,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -20,6 +21,10 @@
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
 //
+// Since a transaction commits only when no system call is in it,
+// a finished write may still be in the in-memory log; log_force()
+// waits until it has been committed.
+//
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
 //   header block, containing block #s for block A, B, C, ...
@@ -40,8 +45,11 @@ struct log {
 	struct spinlock lock;
 	int start;
 	int size;
+	int cap;         // most blocks a transaction may log
 	int outstanding; // how many FS sys calls are executing.
 	int committing;  // in commit(), please wait.
+	int forcing;     // log_force() waiting; hold off new operations.
+	uint ncommit;    // commits completed, for log_force().
 	int dev;
 	struct logheader lh;
 };
@@ -58,9 +66,15 @@ initlog(int dev)
 
 	struct superblock sb;
 	initlock(&log.lock, "log");
+	tracklock(&log.lock);
 	readsb(dev, &sb);
 	log.start = sb.logstart;
 	log.size = sb.nlog;
+	// One block holds the header; the in-memory header has room
+	// for LOGSIZE more.  mkfs may give us fewer.
+	log.cap = log.size - 1 < LOGSIZE ? log.size - 1 : LOGSIZE;
+	if(log.cap < MAXOPBLOCKS)
+		panic("initlog: log too small");
 	log.dev = dev;
 	recover_from_log();
 }
@@ -127,9 +141,9 @@ begin_op(void)
 {
 	acquire(&log.lock);
 	while(1){
-		if(log.committing){
+		if(log.committing || log.forcing){
 			sleep(&log, &log.lock);
-		} else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+		} else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > log.cap){
 			// this op might exhaust log space; wait for commit.
 			sleep(&log, &log.lock);
 		} else {
@@ -168,11 +182,32 @@ end_op(void)
 		commit();
 		acquire(&log.lock);
 		log.committing = 0;
+		log.ncommit++;
 		wakeup(&log);
 		release(&log.lock);
 	}
 }
 
+// Wait until every block logged so far is committed to disk.
+// New operations are held off meanwhile, so that the outstanding
+// ones drain and the transaction commits.
+void
+log_force(void)
+{
+	uint seq;
+
+	acquire(&log.lock);
+	if(log.lh.n > 0 || log.committing){
+		seq = log.ncommit;
+		log.forcing++;
+		while(log.ncommit == seq)
+			sleep(&log, &log.lock);
+		log.forcing--;
+		wakeup(&log);
+	}
+	release(&log.lock);
+}
+
 // Copy modified blocks from cache to log.
 static void
 write_log(void)
@@ -193,11 +228,13 @@ static void
 commit()
 {
 	if (log.lh.n > 0) {
+		traceevent(TR_COMMIT, log.lh.n, 0);
 		write_log();     // Write modified blocks from cache to log
 		write_head();    // Write header to disk -- the real commit
 		install_trans(); // Now install writes to home locations
 		log.lh.n = 0;
 		write_head();    // Erase the transaction from the log
+		traceevent(TR_COMMITDONE, 0, 0);
 	}
 }
 
@@ -215,7 +252,7 @@ log_write(struct buf *b)
 {
 	int i;
 
-	if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+	if (log.lh.n >= log.cap)
 		panic("too big a transaction");
 	if (log.outstanding < 1)
 		panic("log_write outside of trans");
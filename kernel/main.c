@@ -19,9 +19,11 @@ int
 main(void)
 {
 	kinit1(end, P2V(4*1024*1024)); // phys page allocator
+	kminit();        // small-object allocator
 	kvmalloc();      // kernel page table
 	mpinit();        // detect other processors
 	lapicinit();     // interrupt controller
+	timerinit();     // clock ticks
 	seginit();       // segment descriptors
 	picinit();       // disable pic
 	ioapicinit();    // another interrupt controller
@@ -29,12 +31,19 @@ main(void)
 	uartinit();      // serial port
 	pinit();         // process table
 	tvinit();        // trap vectors
+	traceinit();     // event tracing
+	profinit();      // sampling profiler
 	binit();         // buffer cache
 	fileinit();      // file table
 	ideinit();       // disk
 	startothers();   // start other processors
 	kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
+#ifdef STRBENCH
+	strbench();      // string routine throughput, see string.c
+#endif
+	kinfoinit();     // info page mapped into processes
 	userinit();      // first user process
+	kzeroinit();     // page-zeroing kernel thread
 	init_shared_mem_objects(); // Initialize the shared memory objects, see shmem.c
 	mpmain();        // finish this processor's setup
 	// all initialization must go before this line mpmain();
@@ -57,6 +66,7 @@ mpmain(void)
 {
 	cprintf("cpu%d: starting %d\n", cpuid(), cpuid());
 	idtinit();       // load idt register
+	sysenterinit();  // fast system call entry
 	xchg(&(mycpu()->started), 1); // tell startothers() we're up
 	scheduler();     // start running processes
 }
@@ -19,9 +19,15 @@
 
 //==============================ADDED MACROS==============================
 #define PAGESIZE          4096    // bytes mapped by a page
-#define MAX_PAGES 32
+#define MAX_PAGES 4096  // 16 MiB per shm object, backed lazily
 #define SHM_OBJ_MAX_SIZE MAX_PAGES * PAGESIZE
 #define LOCAL_NUMBER_OF_SHM_OBJ 16
 #define VIRT_SHM_MEM KERNBASE - (SHM_OBJ_MAX_SIZE * LOCAL_NUMBER_OF_SHM_OBJ)
+// aio submission/completion rings, just below the shm window.
+#define VIRT_AIO_RING (VIRT_SHM_MEM - PAGESIZE)
+// Read-only kernel info pages (see kinfo.h), just below that.
+// The heap must stay below them.
+#define VIRT_KINFO (VIRT_AIO_RING - 2*PAGESIZE)
+#define VIRT_PINFO (VIRT_KINFO + PAGESIZE)
 //==============================ADDED MACROS==============================
 #endif
\ No newline at end of file
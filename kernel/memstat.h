@@ -0,0 +1,32 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+// Both the kernel and user programs use this header file.
+// All sizes are in 4096-byte pages.
+
+// Physical memory as a whole, filled in by memstat().
+struct memstat {
+	uint total;     // pages managed by kalloc
+	uint free;      // on the free list
+	uint zeroed;    // free and already zeroed
+	uint slab;      // held by kmalloc slabs
+	uint shm;       // backing shared memory objects
+	uint bcache;    // buffer cache (static, not from kalloc)
+	uint swaptotal; // swap slots on disk
+	uint swapfree;
+};
+
+// One process, filled in by memstat().
+struct procmem {
+	int pid;
+	int state;      // enum procstate in proc.h
+	char name[16];
+	uint sz;        // size of process memory in bytes
+	uint rss;       // resident pages, shm pages included
+	uint shm;       // resident pages in the shm window
+	uint swap;      // pages out in swap
+	uint minflt;    // faults served without I/O
+	uint majflt;    // faults that read a page from swap
+};
+
+#endif
@@ -5,7 +5,9 @@
 // x86 memory management unit (MMU).
 
 // Eflags register
+#define FL_TF           0x00000100      // Trap Flag (single step)
 #define FL_IF           0x00000200      // Interrupt Enable
+#define FL_NT           0x00004000      // Nested Task
 
 // Control Register flags
 #define CR0_PE          0x00000001      // Protection Enable
@@ -97,18 +99,22 @@
 #define NPDENTRIES      1024    // # directory entries per page directory
 #define NPTENTRIES      1024    // # PTEs per page table
 #define PGSIZE          4096    // bytes mapped by a page
+#define BIGPGSIZE       (NPTENTRIES*PGSIZE)  // bytes mapped by a PTE_PS directory entry
 
 #define PTXSHIFT        12      // offset of PTX in a linear address
 #define PDXSHIFT        22      // offset of PDX in a linear address
 
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
+#define BIGPGROUNDDOWN(a) ((a) & ~(BIGPGSIZE-1))
 
 // Page table/directory entry flags.
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
+#define PTE_A           0x020   // Accessed
 #define PTE_PS          0x080   // Page Size
+#define PTE_SWAP        0x200   // Not present, address bits hold a swap slot
 
 // Address in page table or page directory entry
 
@@ -1,18 +1,26 @@
 #ifndef PARAM_H
 #define PARAM_H
 
-#define NPROC        64  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
+#define HZ          100  // clock ticks per second
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define MAXPATH     128  // max path name, for kernel copies
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // default file system size in blocks (mkfs -s)
+#define SWAPBLOCKS  16384  // swap area after the file system, in blocks
+#define SWAPBATCH      16  // pages to evict each time memory runs out
+#define PIPEPAGES     4  // pages per pipe buffer (power of two)
+#define NPOLLFD      64  // max pollfd entries per poll() call
+#define NLOCKSTAT    16  // max locks reported by lockdump()
+#define SLEEPSPIN  4096  // max spins on a running sleeplock holder
+#define NZEROPAGES  256  // pre-zeroed pages kept by the kzero thread
+#define NTRACE     1024  // events in each CPU's trace ring
+#define NPROF      1024  // samples in each CPU's profile buffer
 
 #endif
\ No newline at end of file
@@ -7,47 +7,75 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 
-#define PIPESIZE 512
+// The ring is PIPEPAGES separately allocated pages. PIPEPAGES
+// must be a power of two so that the free-running nread/nwrite
+// counters stay consistent with the ring when they wrap.
+#define PIPESIZE (PIPEPAGES*PGSIZE)
 
 struct pipe {
 	struct spinlock lock;
-	char data[PIPESIZE];
+	char *data[PIPEPAGES];
 	uint nread;     // number of bytes read
 	uint nwrite;    // number of bytes written
 	int readopen;   // read fd is still open
 	int writeopen;  // write fd is still open
+	int rbusy;      // splice is draining the ring without the lock
+	int wbusy;      // splice is filling the ring without the lock
+	struct waitq pollq;  // processes in poll() on either end
 };
 
+static void
+pipefree(struct pipe *p)
+{
+	int i;
+
+	for(i = 0; i < PIPEPAGES; i++)
+		if(p->data[i])
+			kfree(p->data[i]);
+	kmfree(p);
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
 	struct pipe *p;
+	int i;
 
 	p = 0;
 	*f0 = *f1 = 0;
 	if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
 		goto bad;
-	if((p = (struct pipe*)kalloc()) == 0)
+	if((p = kmalloc(sizeof(*p))) == 0)
 		goto bad;
+	memset(p->data, 0, sizeof(p->data));
+	for(i = 0; i < PIPEPAGES; i++)
+		if((p->data[i] = kalloc()) == 0)
+			goto bad;
 	p->readopen = 1;
 	p->writeopen = 1;
 	p->nwrite = 0;
 	p->nread = 0;
+	p->rbusy = 0;
+	p->wbusy = 0;
+	p->pollq.head = 0;
 	initlock(&p->lock, "pipe");
 	(*f0)->type = FD_PIPE;
 	(*f0)->readable = 1;
 	(*f0)->writable = 0;
+	(*f0)->nonblock = 0;
 	(*f0)->pipe = p;
 	(*f1)->type = FD_PIPE;
 	(*f1)->readable = 0;
 	(*f1)->writable = 1;
+	(*f1)->nonblock = 0;
 	(*f1)->pipe = p;
 	return 0;
 
 	bad:
 	if(p)
-		kfree((char*)p);
+		pipefree(p);
 	if(*f0)
 		fileclose(*f0);
 	if(*f1)
@@ -66,54 +94,216 @@ pipeclose(struct pipe *p, int writable)
 		p->readopen = 0;
 		wakeup(&p->nwrite);
 	}
+	waitqwakeup(&p->pollq);
 	if(p->readopen == 0 && p->writeopen == 0){
 		release(&p->lock);
-		kfree((char*)p);
+		pipefree(p);
 	} else
 		release(&p->lock);
 }
 
+// Return the longest run of the ring starting at counter pos that
+// lies within one page and is at most max bytes long.
+static char*
+pipechunk(struct pipe *p, uint pos, uint max, uint *len)
+{
+	uint off;
+
+	off = pos % PIPESIZE;
+	*len = PGSIZE - off%PGSIZE;
+	if(*len > max)
+		*len = max;
+	return p->data[off/PGSIZE] + off%PGSIZE;
+}
+
+// Wait until the ring has room and no splice is filling it.
+// Called with p->lock held. Returns -1 if the reader is gone,
+// 1 if nonblock is set and the wait would block.
+static int
+pipewaitspace(struct pipe *p, int nonblock)
+{
+	while(p->nwrite == p->nread + PIPESIZE || p->wbusy){  //DOC: pipewrite-full
+		if(p->readopen == 0 || myproc()->killed)
+			return -1;
+		if(nonblock)
+			return 1;
+		wakeup(&p->nread);
+		sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+	}
+	return 0;
+}
+
+// Wait until the ring has data (or the writer is gone) and no
+// splice is draining it. Called with p->lock held.
+static int
+pipewaitdata(struct pipe *p, int nonblock)
+{
+	while((p->nread == p->nwrite && p->writeopen) || p->rbusy){  //DOC: pipe-empty
+		if(myproc()->killed || nonblock)
+			return -1;
+		sleep(&p->nread, &p->lock); //DOC: piperead-sleep
+	}
+	return 0;
+}
+
+// Write n bytes from addr. With nonblock, write only what fits
+// and return that count, or -1 if nothing fits.
 int
-pipewrite(struct pipe *p, char *addr, int n)
+pipewrite(struct pipe *p, char *addr, int n, int nonblock)
 {
-	int i;
+	int i, r;
+	uint m;
+	char *dst;
 
 	acquire(&p->lock);
-	for(i = 0; i < n; i++){
-		while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
-			if(p->readopen == 0 || myproc()->killed){
-				release(&p->lock);
-				return -1;
-			}
-			wakeup(&p->nread);
-			sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+	for(i = 0; i < n; i += m){
+		if((r = pipewaitspace(p, nonblock)) != 0){
+			if(r > 0 && i > 0)
+				break;
+			release(&p->lock);
+			return -1;
 		}
-		p->data[p->nwrite++ % PIPESIZE] = addr[i];
+		dst = pipechunk(p, p->nwrite, n - i, &m);
+		if(m > p->nread + PIPESIZE - p->nwrite)
+			m = p->nread + PIPESIZE - p->nwrite;
+		memmove(dst, addr + i, m);
+		p->nwrite += m;
 	}
 	wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+	waitqwakeup(&p->pollq);
 	release(&p->lock);
-	return n;
+	return i;
 }
 
+// Read up to n bytes into addr. With nonblock, return -1
+// instead of waiting for data.
 int
-piperead(struct pipe *p, char *addr, int n)
+piperead(struct pipe *p, char *addr, int n, int nonblock)
 {
 	int i;
+	uint m;
+	char *src;
 
 	acquire(&p->lock);
-	while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
-		if(myproc()->killed){
-			release(&p->lock);
-			return -1;
-		}
-		sleep(&p->nread, &p->lock); //DOC: piperead-sleep
+	if(pipewaitdata(p, nonblock) < 0){
+		release(&p->lock);
+		return -1;
 	}
-	for(i = 0; i < n; i++){  //DOC: piperead-copy
-		if(p->nread == p->nwrite)
-			break;
-		addr[i] = p->data[p->nread++ % PIPESIZE];
+	for(i = 0; i < n && p->nread != p->nwrite; i += m){  //DOC: piperead-copy
+		src = pipechunk(p, p->nread, n - i, &m);
+		if(m > p->nwrite - p->nread)
+			m = p->nwrite - p->nread;
+		memmove(addr + i, src, m);
+		p->nread += m;
 	}
 	wakeup(&p->nwrite);  //DOC: piperead-wakeup
+	waitqwakeup(&p->pollq);
+	release(&p->lock);
+	return i;
+}
+
+// Report POLL* readiness of the read (writable == 0) or write
+// end of the pipe, and add or remove the caller as a poller.
+int
+pipepoll(struct pipe *p, int writable, int how)
+{
+	int r;
+
+	acquire(&p->lock);
+	if(how == WQ_ADD)
+		waitqadd(&p->pollq, myproc());
+	else if(how == WQ_DEL)
+		waitqdel(&p->pollq, myproc());
+	r = 0;
+	if(writable){
+		if(p->readopen == 0)
+			r |= POLLERR;
+		else if(p->nwrite != p->nread + PIPESIZE && !p->wbusy)
+			r |= POLLOUT;
+	} else {
+		if(p->nread != p->nwrite && !p->rbusy)
+			r |= POLLIN;
+		if(p->writeopen == 0)
+			r |= POLLHUP;
+	}
+	release(&p->lock);
+	return r;
+}
+
+// Move up to n bytes from the pipe to file f, straight from the
+// ring pages. Waits for data like piperead(). The chunk being
+// written stays in the ring (rbusy keeps other readers out) until
+// filewrite() returns, since filewrite() may sleep.
+// Returns the number of bytes moved, or -1.
+int
+pipespliceout(struct pipe *p, struct file *f, int n)
+{
+	int i, r;
+	uint m;
+	char *src;
+
+	r = 0;
+	acquire(&p->lock);
+	if(pipewaitdata(p, 0) < 0){
+		release(&p->lock);
+		return -1;
+	}
+	p->rbusy = 1;
+	for(i = 0; i < n && p->nread != p->nwrite; i += r){
+		src = pipechunk(p, p->nread, n - i, &m);
+		if(m > p->nwrite - p->nread)
+			m = p->nwrite - p->nread;
+		release(&p->lock);
+		r = filewrite(f, src, m);
+		acquire(&p->lock);
+		if(r <= 0)
+			break;
+		p->nread += r;
+		wakeup(&p->nwrite);
+	}
+	p->rbusy = 0;
+	wakeup(&p->nread);
+	waitqwakeup(&p->pollq);
+	release(&p->lock);
+	if(i == 0 && r < 0)
+		return -1;
+	return i;
+}
+
+// Move up to n bytes from file f into the pipe, reading directly
+// into the ring pages. Stops early at end of file.
+// Returns the number of bytes moved, or -1.
+int
+pipesplicein(struct pipe *p, struct file *f, int n)
+{
+	int i, r;
+	uint m;
+	char *dst;
+
+	r = 0;
+	acquire(&p->lock);
+	for(i = 0; i < n; i += r){
+		if(pipewaitspace(p, 0) < 0){
+			r = -1;
+			break;
+		}
+		dst = pipechunk(p, p->nwrite, n - i, &m);
+		if(m > p->nread + PIPESIZE - p->nwrite)
+			m = p->nread + PIPESIZE - p->nwrite;
+		p->wbusy = 1;
+		release(&p->lock);
+		r = fileread(f, dst, m);
+		acquire(&p->lock);
+		p->wbusy = 0;
+		if(r <= 0)
+			break;
+		p->nwrite += r;
+		wakeup(&p->nread);
+	}
+	wakeup(&p->nwrite);
+	waitqwakeup(&p->pollq);
 	release(&p->lock);
+	if(i == 0 && r < 0)
+		return -1;
 	return i;
 }
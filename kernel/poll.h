@@ -0,0 +1,18 @@
+#ifndef POLL_H
+#define POLL_H
+
+// Both the kernel and user programs use this header file.
+
+struct pollfd {
+	int fd;         // File descriptor to watch (ignored if negative)
+	short events;   // Requested events
+	short revents;  // Returned events
+};
+
+#define POLLIN   0x001  // Data can be read without blocking
+#define POLLOUT  0x004  // Data can be written without blocking
+#define POLLERR  0x008  // Write end of a pipe with no reader
+#define POLLHUP  0x010  // Read end of a pipe with no writer
+#define POLLNVAL 0x020  // fd is not open
+
+#endif
@@ -8,13 +8,23 @@
 #include "spinlock.h"
 #include "shmem.h"
 #include "vm.h"
-
+#include "memstat.h"
+#include "traps.h"
+#include "timer.h"
+#include "trace.h"
+
+// Proc structures are kmalloc()ed by allocproc() and kmfree()d by
+// freeproc() when they are reaped, so the list holds only live
+// processes.  Both happen with ptable.lock held: walk the list
+// under it, and do not use a proc pointer kept across a release
+// without finding it on the list again (see swapgrab).
 struct {
 	struct spinlock lock;
-	struct proc proc[NPROC];
+	struct proc *list;
 } ptable;
 
 static struct proc *initproc;
+extern pde_t *kernel_page_directory;
 
 int nextpid = 1;
 extern void forkret(void);
@@ -26,6 +36,7 @@ void
 pinit(void)
 {
 	initlock(&ptable.lock, "ptable");
+	tracklock(&ptable.lock);
 }
 
 // Must be called with interrupts disabled
@@ -69,34 +80,52 @@ myproc(void)
 	return p;
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
-// state required to run in the kernel.
-// Otherwise return 0.
+// Unlink p from the process table and free it.  Its kernel stack
+// and page table must be gone already.  Caller holds ptable.lock.
+static void
+freeproc(struct proc *p)
+{
+	struct proc **pp;
+
+	for(pp = &ptable.list; *pp != p; pp = &(*pp)->next)
+		if(*pp == 0)
+			panic("freeproc");
+	*pp = p->next;
+	kmfree(p);
+}
+
+// Allocate a proc and add it to the process table.  Change its
+// state to EMBRYO and initialize state required to run in the
+// kernel.  Return 0 if out of memory.
 static struct proc*
 allocproc(void)
 {
 	struct proc *p;
 	char *sp;
 
-	acquire(&ptable.lock);
-
-	for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-		if(p->state == UNUSED)
-			goto found;
-
-	release(&ptable.lock);
-	return 0;
+	if((p = kmalloc(sizeof(*p))) == 0)
+		return 0;
+	memset(p, 0, sizeof(*p));
 
-found:
+	acquire(&ptable.lock);
+	p->next = ptable.list;
+	ptable.list = p;
 	p->state = EMBRYO;
 	p->pid = nextpid++;
+	p->aio = 0;
+	p->insyscall = 0;
+	p->swapping = 0;
+	p->nswapped = 0;
+	p->minflt = 0;
+	p->majflt = 0;
 
 	release(&ptable.lock);
 
 	// Allocate kernel stack.
 	if((p->kstack = kalloc()) == 0){
-		p->state = UNUSED;
+		acquire(&ptable.lock);
+		freeproc(p);
+		release(&ptable.lock);
 		return 0;
 	}
 	sp = p->kstack + KSTACKSIZE;
@@ -131,6 +160,8 @@ userinit(void)
 	if((p->pgdir = setupkvm()) == 0)
 		panic("userinit: out of memory?");
 	inituvm(p->pgdir, _binary_user_initcode_start, (int)_binary_user_initcode_size);
+	if(kinfomap(p->pgdir, p->pid) < 0)
+		panic("userinit: kinfomap");
 	p->sz = PGSIZE;
 	memset(p->tf, 0, sizeof(*p->tf));
 	p->tf->cs = (SEG_UCODE << 3) | DPL_USER;
@@ -173,48 +204,21 @@ growproc(int n)
 		if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
 			return -1;
 	} else if(n < 0){
-		if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
+		// Keep the aio worker out of the pages we are about to free.
+		if(curproc->aio)
+			aiopause(curproc, 1);
+		sz = deallocuvm(curproc->pgdir, sz, sz + n);
+		if(sz != 0)
+			curproc->sz = sz;
+		if(curproc->aio)
+			aiopause(curproc, 0);
+		if(sz == 0)
 			return -1;
 	}
 	curproc->sz = sz;
-	switchuvm(curproc);
 	return 0;
 }
 
-void copy_shm_vm(struct proc* parent, struct proc* child){
-    cprintf("ENTERED COPY SHM_VM PROC\n");
-    pte_t* pte;
-    uint start, stop;
-    start = VIRT_SHM_MEM;
-    stop = KERNBASE;
-    for (; start < stop; start += PGSIZE){
-        pte = walkpgdir(parent->pgdir, (void*)start, 0);
-        if (pte && (*pte & PTE_P)){
-            uint physical_adress = PTE_ADDR(*pte);
-            int flags = PTE_FLAGS(*pte);
-            mappages(child->pgdir, (void*)start, PGSIZE, physical_adress, flags | PTE_U);
-			cprintf("maped one page");
-        }
-    }
-}
-void copy_shm_vm_1(struct proc* parent, struct proc* child, int object_descriptor, int flags){
-	pte_t* pte;
-	uint start;
-	struct shared_memory_object** shared_mem_obj_glob = &parent->shared_mem_objects[object_descriptor].shared_mem_object;
-	start = (PGROUNDUP(VIRT_SHM_MEM) + (object_descriptor * SHM_OBJ_MAX_SIZE));
-	for (int i = 0; i <= (*shared_mem_obj_glob)->allocated_pages; i ++){
-		if (mappages(child->pgdir, (char*) start, PGSIZE, V2P((*shared_mem_obj_glob)->memory[i]), flags | PTE_U) < 0){
-            if (i > 0){
-				cprintf("FAILED IN PROC.c THIS SHOULD NOT HAPPEN");
-                //unmap(current_proc->pgdir, persistent_address, address);
-                //return -1;
-            }
-        }
-        start += PGSIZE;
-	} 
-
-}
-
 // Create a new process copying p as the parent.
 // Sets up stack to return as if from system call.
 // Caller must set state of returned proc to RUNNABLE.
@@ -231,29 +235,38 @@ fork(void)
 	}
 
 	// Copy process state from proc.
-	if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+	// The info pages lie above sz; the child gets its own.
+	if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0 ||
+	   kinfomap(np->pgdir, np->pid) < 0){
+		if(np->pgdir)
+			freevm(np->pgdir);
+		np->pgdir = 0;
 		kfree(np->kstack);
-		np->kstack = 0;
-		np->state = UNUSED;
+		acquire(&ptable.lock);
+		freeproc(np);
+		release(&ptable.lock);
 		return -1;
 	}
 	np->sz = curproc->sz;
 	np->parent = curproc;
 	*np->tf = *curproc->tf;
+	// The child shares the parent's shm objects at the same addresses
+	// but starts with none of their pages in its page table; it
+	// faults them in as it touches them (see shm_fault), so fork costs
+	// the same however much shared memory is mapped.
 	for (int i = 0; i < 16; i ++){
-		np->shared_mem_objects[i].shared_mem_object = curproc->shared_mem_objects[i].shared_mem_object;
-		np->shared_mem_objects[i].flags = curproc->shared_mem_objects[i].flags;
-		np->shared_mem_objects[i].virtual_adress = curproc->shared_mem_objects[i].virtual_adress;
-		int flags, va, shm_obj;
-		flags = np->shared_mem_objects[i].flags;
-		va = np->shared_mem_objects[i].virtual_adress;
-		shm_obj = (int)np->shared_mem_objects[i].shared_mem_object;
-		if (curproc->shared_mem_objects[i].shared_mem_object && curproc->shared_mem_objects[i].shared_mem_object->name[0] != 0){
-			curproc->shared_mem_objects[i].shared_mem_object->ref_count ++;
-			copy_shm_vm_1(curproc, np, i, curproc->shared_mem_objects[i].flags);
+		struct shared_memory_object* shm_obj = curproc->shared_mem_objects[i].shared_mem_object;
+		np->shared_mem_objects[i] = curproc->shared_mem_objects[i];
+		// exit() closes every non-null slot, so take a reference on each
+		if (shm_obj){
+			shm_obj_dup(shm_obj);
+			if (np->shared_mem_objects[i].virtual_adress){
+				acquire(&shm_obj->lock);
+				shm_obj->map_count ++;
+				release(&shm_obj->lock);
+			}
 		}
 	}
-	//copy_shm_vm(curproc, np);
 	// Clear %eax so that fork returns 0 in the child.
 	np->tf->eax = 0;
 
@@ -274,6 +287,80 @@ fork(void)
 	return pid;
 }
 
+// Kernel threads run entirely in the kernel on behalf of the process
+// that created them, borrowing its page table so that they can touch
+// its user memory.  They have no parent; the creator must reap them
+// with kthreadjoin() before its page table goes away.  Threads
+// created at boot, with no current process, run on the kernel page
+// table and never exit.
+static void
+kthreadstart(void)
+{
+	struct proc *p;
+
+	// Still holding ptable.lock from scheduler.
+	release(&ptable.lock);
+
+	p = myproc();
+	p->kfn(p->karg);
+	kthreadexit();
+}
+
+struct proc*
+kthreadcreate(void (*fn)(void*), void *arg, char *name)
+{
+	struct proc *np;
+	struct proc *curproc = myproc();
+
+	if((np = allocproc()) == 0)
+		return 0;
+	np->pgdir = curproc ? curproc->pgdir : kernel_page_directory;
+	np->sz = 0;
+	np->parent = 0;
+	np->kfn = fn;
+	np->karg = arg;
+	np->context->eip = (uint)kthreadstart;
+	memset(np->shared_mem_objects, 0, sizeof(np->shared_mem_objects));
+	memset(np->ofile, 0, sizeof(np->ofile));
+	np->cwd = curproc ? idup(curproc->cwd) : 0;
+	safestrcpy(np->name, name, sizeof(np->name));
+
+	acquire(&ptable.lock);
+	np->state = RUNNABLE;
+	release(&ptable.lock);
+	return np;
+}
+
+// Finish the current kernel thread.  Does not return.
+void
+kthreadexit(void)
+{
+	struct proc *p = myproc();
+
+	begin_op();
+	iput(p->cwd);
+	end_op();
+	p->cwd = 0;
+
+	acquire(&ptable.lock);
+	wakeup1(p);
+	p->state = ZOMBIE;
+	sched();
+	panic("kthread exit");
+}
+
+// Wait for kernel thread p to finish and free it.
+void
+kthreadjoin(struct proc *p)
+{
+	acquire(&ptable.lock);
+	while(p->state != ZOMBIE)
+		sleep(p, &ptable.lock);
+	kfree(p->kstack);
+	freeproc(p);
+	release(&ptable.lock);
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
@@ -282,11 +369,15 @@ exit(void)
 {
 	struct proc *curproc = myproc();
 	struct proc *p;
-	int fd;
+	int fd, i;
 
 	if(curproc == initproc)
 		panic("init exiting");
 
+	// Stop the aio worker before it loses our files and memory.
+	if(curproc->aio)
+		aiostop(curproc);
+
 	// Close all open files.
 	for(fd = 0; fd < NOFILE; fd++){
 		if(curproc->ofile[fd]){
@@ -295,6 +386,11 @@ exit(void)
 		}
 	}
 
+	// Drop our shared memory objects; the last reference frees them.
+	for(i = 0; i < SHM_OBJECTS_PER_PROC; i++)
+		if(curproc->shared_mem_objects[i].shared_mem_object)
+			shm_close_direct(i, curproc);
+
 	begin_op();
 	iput(curproc->cwd);
 	end_op();
@@ -306,7 +402,7 @@ exit(void)
 	wakeup1(curproc->parent);
 
 	// Pass abandoned children to init.
-	for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+	for(p = ptable.list; p; p = p->next){
 		if(p->parent == curproc){
 			p->parent = initproc;
 			if(p->state == ZOMBIE)
@@ -320,26 +416,6 @@ exit(void)
 	panic("zombie exit");
 }
 
-void clean_shm_mem(struct shared_memory_object* shm_obj){
-    for (int i = 0; i <= shm_obj->allocated_pages; i ++){
-        kfree(shm_obj->memory[i]);
-    }
-}
-
-void unmap1(pde_t* pgdir, uint from, uint to){
-   // cprintf("Unmap got called \n");
-    pte_t* page_table_entry;
-    uint adress = PGROUNDUP(from);
-    for (; adress < to; adress += PGSIZE){
-        
-        page_table_entry =  walkpgdir(pgdir, (char*)adress, 0);
-        if (*page_table_entry & PTE_P){
-            cprintf("UNMAPED ONE PAGE\n");
-			*page_table_entry = 0;
-        }
-    }
-}
-
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
 int
@@ -353,42 +429,16 @@ wait(void)
 	for(;;){
 		// Scan through table looking for exited children.
 		havekids = 0;
-		for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+		for(p = ptable.list; p; p = p->next){
 			if(p->parent != curproc)
 				continue;
 			havekids = 1;
 			if(p->state == ZOMBIE){
 				// Found one.
-				for (int obj = 0; obj < 16; obj++){
-					if (p->shared_mem_objects[obj].shared_mem_object != 0 && p->shared_mem_objects[obj].shared_mem_object->name[0] != 0){
-						//cprintf("id:%d\n", obj);
-						//shm_close_direct(obj, p);
-						struct shared_memory_object** shared_mem_obj_glob = &p->shared_mem_objects[obj].shared_mem_object;
-						p->shared_mem_objects[obj].flags = 0;
-						(*shared_mem_obj_glob)->ref_count --;
-						uint oldsz = PGROUNDUP(VIRT_SHM_MEM) + (obj * SHM_OBJ_MAX_SIZE);
-        				uint newsz = oldsz + (*shared_mem_obj_glob)->size;
-						unmap1(p->pgdir, oldsz, newsz);
-						if ((*shared_mem_obj_glob)->ref_count == 0){
-							clean_shm_mem((*shared_mem_obj_glob));
-							(*shared_mem_obj_glob)->allocated_pages = -1;
-							(*shared_mem_obj_glob)->size = 0; 
-						}
-
-						memset((*shared_mem_obj_glob)->name, 0, 14);
-						p->shared_mem_objects[obj].virtual_adress = 0;
-						p->shared_mem_objects[obj].shared_mem_object = 0;
-					}
-				}
 				pid = p->pid;
 				kfree(p->kstack);
-				p->kstack = 0;
 				freevm(p->pgdir);
-				p->pid = 0;
-				p->parent = 0;
-				p->name[0] = 0;
-				p->killed = 0;
-				p->state = UNUSED;
+				freeproc(p);
 				release(&ptable.lock);
 				return pid;
 			}
@@ -406,6 +456,39 @@ wait(void)
 }
 
 // Per-CPU process scheduler.
+// Is there a process scheduler() could run?
+static int
+anyrunnable(void)
+{
+	struct proc *p;
+
+	acquire(&ptable.lock);
+	for(p = ptable.list; p; p = p->next)
+		if(p->state == RUNNABLE && !p->swapping)
+			break;
+	release(&ptable.lock);
+	return p != 0;
+}
+
+// A process just became runnable.  Unless this CPU is about to
+// look for it anyway, send an idle CPU to run it.  Caller holds
+// ptable.lock.
+static void
+kickidle(void)
+{
+	struct cpu *c;
+
+	if(mycpu()->proc == 0)
+		return;
+	for(c = cpus; c < cpus+ncpu; c++){
+		if(c->idle){
+			c->idle = 0;
+			lapicipi(c->apicid, T_WAKEUP);
+			return;
+		}
+	}
+}
+
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
 //  - choose a process to run
@@ -420,21 +503,32 @@ scheduler(void)
 	struct cpu *c = mycpu();
 	c->proc = 0;
 
+	timerbusy();
 	idle = 0;
 	for(;;){
 		// Enable interrupts on this processor.
 		sti();
 
-		// If there are no processes to run, halt the CPU
-		// until the next interrupt.
-		if(idle)
-			hlt();
+		// If there are no processes to run, halt the CPU until
+		// the next interrupt, with the clock tick off.  Once idle
+		// is set, a process made runnable elsewhere brings an IPI
+		// (see kickidle), so look once more after setting it.
+		if(idle && !kzeroidle()){
+			cli();
+			c->idle = 1;
+			if(!anyrunnable()){
+				timeridle();
+				stihlt();
+				timerbusy();
+			}
+			c->idle = 0;
+		}
 		idle = 1;
 
 		// Loop over process table looking for process to run.
 		acquire(&ptable.lock);
-		for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-			if(p->state != RUNNABLE)
+		for(p = ptable.list; p; p = p->next){
+			if(p->state != RUNNABLE || p->swapping)
 				continue;
 
 			idle = 0;
@@ -444,10 +538,11 @@ scheduler(void)
 			c->proc = p;
 			switchuvm(p);
 			p->state = RUNNING;
+			traceevent(TR_SWITCHIN, p->pid, 0);
 
 			swtch(&(c->scheduler), p->context);
-			// briefly activates the kernel code between each process, to manage interrupts and such
-			switchkvm();
+			// Keep p's page table loaded: the next process may
+			// well share it.  Whoever frees it calls tlbdrop().
 
 			// Process is done running for now.
 			// It should have changed its p->state before coming back.
@@ -480,6 +575,7 @@ sched(void)
 	if(readeflags()&FL_IF)
 		panic("sched interruptible");
 	intena = mycpu()->intena;
+	traceevent(TR_SWITCHOUT, p->pid, p->state);
 	swtch(&p->context, mycpu()->scheduler);
 	mycpu()->intena = intena;
 }
@@ -510,6 +606,7 @@ forkret(void)
 		first = 0;
 		iinit(ROOTDEV);
 		initlog(ROOTDEV);
+		swapinit();
 	}
 
 	// Return to "caller", actually trapret (see allocproc).
@@ -560,10 +657,16 @@ static void
 wakeup1(void *chan)
 {
 	struct proc *p;
+	int woke;
 
-	for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-		if(p->state == SLEEPING && p->chan == chan)
+	woke = 0;
+	for(p = ptable.list; p; p = p->next)
+		if(p->state == SLEEPING && p->chan == chan){
 			p->state = RUNNABLE;
+			woke = 1;
+		}
+	if(woke)
+		kickidle();
 }
 
 // Wake up all processes sleeping on chan.
@@ -575,6 +678,201 @@ wakeup(void *chan)
 	release(&ptable.lock);
 }
 
+// Sleep until futexwake() on the same word, unless the word no
+// longer holds val.  kaddr is the kernel address of a user word,
+// so processes sharing the page meet on the same channel.  Checking
+// the word under ptable.lock closes the race with futexwake().
+int
+futexwait(uint *kaddr, uint val)
+{
+	acquire(&ptable.lock);
+	if(*(volatile uint*)kaddr != val){
+		release(&ptable.lock);
+		return -1;
+	}
+	if(!myproc()->killed)
+		sleep(kaddr, &ptable.lock);
+	release(&ptable.lock);
+	return 0;
+}
+
+void
+futexwake(uint *kaddr)
+{
+	wakeup(kaddr);
+}
+
+// Register p on q, so waitqwakeup(q) will end its pollsleep().
+// Caller holds the lock of the object q belongs to.
+void
+waitqadd(struct waitq *q, struct proc *p)
+{
+	struct waitqent *e;
+
+	for(e = q->head; e; e = e->next)
+		if(e->p == p)
+			return;
+	if((e = kmalloc(sizeof(*e))) == 0){
+		// Cannot register; have pollsleep() return at once
+		// so the caller rescans instead of missing the event.
+		p->pollev = 1;
+		return;
+	}
+	e->p = p;
+	e->next = q->head;
+	q->head = e;
+}
+
+void
+waitqdel(struct waitq *q, struct proc *p)
+{
+	struct waitqent **pp, *e;
+
+	for(pp = &q->head; (e = *pp) != 0; pp = &e->next){
+		if(e->p == p){
+			*pp = e->next;
+			kmfree(e);
+			return;
+		}
+	}
+}
+
+// The object q belongs to changed readiness; wake its pollers.
+// Caller holds the object's lock.
+void
+waitqwakeup(struct waitq *q)
+{
+	struct waitqent *e;
+	struct proc *p;
+
+	if(q->head == 0)
+		return;
+	acquire(&ptable.lock);
+	for(e = q->head; e; e = e->next){
+		p = e->p;
+		p->pollev = 1;
+		if(p->polling && p->state == SLEEPING){
+			p->state = RUNNABLE;
+			kickidle();
+		}
+	}
+	release(&ptable.lock);
+}
+
+// Sleep until one of the waitqs the current process is on is
+// woken. The caller clears pollev before checking readiness, so
+// an event that raced with the check makes this return at once.
+// A timer t, if given, must wake &p->pollev; its firing also
+// ends the sleep.
+void
+pollsleep(struct timer *t)
+{
+	struct proc *p = myproc();
+
+	acquire(&ptable.lock);
+	if(!p->pollev && !p->killed && !(t && t->fired)){
+		p->polling = 1;
+		p->chan = &p->pollev;
+		p->state = SLEEPING;
+		sched();
+		p->chan = 0;
+		p->polling = 0;
+	}
+	release(&ptable.lock);
+}
+
+// Find the first process at or after p in the table, wrapping
+// around, whose pages swapout() may evict: one that is neither
+// running nor inside a system call, and whose address space no
+// kernel thread is using.  Keep it off the CPUs until
+// swaprelease().  Counts wraps past the end of the table in
+// *wraps; returns 0 if there is no such process.
+struct proc*
+swapgrab(struct proc *p, int *wraps)
+{
+	struct proc *q;
+
+	acquire(&ptable.lock);
+	// p may have been freed since the caller saw it.
+	for(q = ptable.list; q && q != p; q = q->next)
+		;
+	if(q == 0)
+		p = ptable.list;
+	q = p;
+	do{
+		if((q->state == RUNNABLE || q->state == SLEEPING) &&
+		   !q->insyscall && !q->swapping && q->aio == 0 &&
+		   q->sz > 0 && q != myproc()){
+			q->swapping = 1;
+			release(&ptable.lock);
+			return q;
+		}
+		if((q = q->next) == 0){
+			q = ptable.list;
+			(*wraps)++;
+		}
+	} while(q != p);
+	release(&ptable.lock);
+	return 0;
+}
+
+// Returns the process after p in the table, or 0 at the end,
+// for the caller to pass to swapgrab() next.
+struct proc*
+swaprelease(struct proc *p)
+{
+	struct proc *next;
+
+	acquire(&ptable.lock);
+	p->swapping = 0;
+	next = p->next;
+	release(&ptable.lock);
+	return next;
+}
+
+// Install a new page table for p.  Done under ptable.lock so that
+// procmem(), which walks other processes' tables, never sees one
+// that is about to be freed.  The new table has nothing in swap.
+void
+setpgdir(struct proc *p, pde_t *pgdir)
+{
+	acquire(&ptable.lock);
+	p->pgdir = pgdir;
+	p->nswapped = 0;
+	release(&ptable.lock);
+}
+
+// Fill in up to n entries of pm with the memory use of live
+// processes.  Returns the number of such processes, which may be
+// more than n.
+int
+procmem(struct procmem *pm, int n)
+{
+	struct proc *p;
+	int i;
+
+	i = 0;
+	acquire(&ptable.lock);
+	for(p = ptable.list; p; p = p->next){
+		// An embryo's or zombie's page table may be going away.
+		if(p->state == UNUSED || p->state == EMBRYO || p->state == ZOMBIE)
+			continue;
+		if(i < n){
+			pm->pid = p->pid;
+			pm->state = p->state;
+			safestrcpy(pm->name, p->name, sizeof(pm->name));
+			pm->sz = p->sz;
+			vmusage(p->pgdir, &pm->rss, &pm->shm, &pm->swap);
+			pm->minflt = p->minflt;
+			pm->majflt = p->majflt;
+			pm++;
+		}
+		i++;
+	}
+	release(&ptable.lock);
+	return i;
+}
+
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
@@ -584,7 +882,7 @@ kill(int pid)
 	struct proc *p;
 
 	acquire(&ptable.lock);
-	for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+	for(p = ptable.list; p; p = p->next){
 		if(p->pid == pid){
 			p->killed = 1;
 			// Wake process from sleep if necessary.
@@ -617,7 +915,7 @@ procdump(void)
 	char *state;
 	uint pc[10];
 
-	for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+	for(p = ptable.list; p; p = p->next){
 		if(p->state == UNUSED)
 			continue;
 		if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
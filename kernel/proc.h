@@ -16,6 +16,10 @@ struct cpu {
 	int ncli;                    // Depth of pushcli nesting.
 	int intena;                  // Were interrupts enabled before pushcli?
 	struct proc *proc;           // The process running on this cpu or null
+	pde_t *pgdir;                // Page table in %cr3, 0 if the kernel's
+	volatile int tlbreq;         // A TLB shootdown awaits this cpu
+	volatile int idle;           // Halted with nothing to run?
+	int ticking;                 // Timer stops at clock ticks? (timer.c)
 };
 
 extern struct cpu cpus[NCPU];
@@ -41,6 +45,17 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// Processes in poll() waiting for an object to become ready.
+// Protected by the lock of the object that embeds it.
+struct waitqent {
+	struct proc *p;
+	struct waitqent *next;
+};
+
+struct waitq {
+	struct waitqent *head;
+};
+
 // Per-process state
 struct proc {
 	uint sz;                     // Size of process memory (bytes)
@@ -56,6 +71,17 @@ struct proc {
 	struct file *ofile[NOFILE];  // Open files
 	struct inode *cwd;           // Current directory
 	char name[16];               // Process name (debugging)
+	int pollev;                  // A waitq we are on was woken
+	int polling;                 // Sleeping in pollsleep()
+	struct aioctx *aio;          // Async I/O rings, if set up
+	void (*kfn)(void*);          // Kernel thread body (see kthreadcreate)
+	void *karg;                  // Argument to kfn
+	struct proc *next;           // Process table list
+	int insyscall;               // In a system call; never swapped
+	int swapping;                // swapout() is scanning our pages
+	int nswapped;                // Pages sent to swap; may overcount
+	uint minflt;                 // Page faults served from memory
+	uint majflt;                 // Page faults that read swap
 	//int shm_occupied[SHM_OBJECTS_PER_PROC];
 	struct shared_memory_object_local shared_mem_objects[SHM_OBJECTS_PER_PROC];
 };
@@ -0,0 +1,139 @@
+// Sampling profiler.
+//
+// While it is on, each timer interrupt records where the CPU was:
+// the interrupted eip and the return addresses found by following
+// the frame pointer chain, in the kernel if the interrupt came
+// from there and in user memory otherwise.  User frames are read
+// through the page table, never by touching user memory, so a bad
+// frame pointer just ends the chain.  Samples go into per-CPU
+// buffers that only their own CPU fills; a full buffer drops
+// samples until it is read.  user/prof.c prints them, and
+// tools/prof2folded.c turns that into folded stacks.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "vm.h"
+#include "prof.h"
+
+struct profbuf {
+	volatile uint head;  // samples recorded
+	uint tail;           // samples read
+	struct profsample s[NPROF];
+};
+
+static struct profbuf bufs[NCPU];
+static struct spinlock proflock;  // one reader at a time
+static volatile int profon;
+
+void
+profinit(void)
+{
+	initlock(&proflock, "prof");
+}
+
+// Follow kernel frames from ebp into pcs[i..].  Returns the new depth.
+static int
+kernpcs(uint ebp, uint *pcs, int i)
+{
+	uint *fp;
+
+	for(; i < NPROFPCS; i++){
+		fp = (uint*)ebp;
+		if(ebp < KERNBASE || ebp >= (uint)P2V(PHYSTOP) - 8 || ebp % 4)
+			break;
+		pcs[i] = fp[1];
+		ebp = fp[0];
+	}
+	return i;
+}
+
+// Follow p's user frames from ebp into pcs[i..].
+static int
+userpcs(struct proc *p, uint ebp, uint *pcs, int i)
+{
+	pte_t *pte;
+	uint *fp;
+
+	for(; i < NPROFPCS; i++){
+		if(ebp >= p->sz || ebp % 4 || ebp % PGSIZE > PGSIZE - 8)
+			break;
+		pte = walkpgdir(p->pgdir, (char*)ebp, 0);
+		if(pte == 0 || (*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+			break;
+		fp = (uint*)((char*)P2V(PTE_ADDR(*pte)) + ebp % PGSIZE);
+		pcs[i] = fp[1];
+		ebp = fp[0];
+	}
+	return i;
+}
+
+// Timer interrupt: take a sample of the code tf interrupted.
+void
+profsample(struct trapframe *tf)
+{
+	struct profbuf *b;
+	struct profsample *s;
+	struct cpu *c;
+	struct proc *p;
+
+	if(!profon)
+		return;
+	c = mycpu();
+	b = &bufs[c - cpus];
+	if(b->head - b->tail == NPROF)
+		return;
+	p = c->proc;
+	s = &b->s[b->head % NPROF];
+	s->cpu = c - cpus;
+	s->pid = p ? p->pid : 0;
+	safestrcpy(s->name, p ? p->name : "", sizeof(s->name));
+	s->pcs[0] = tf->eip;
+	if((tf->cs&3) == DPL_USER)
+		s->depth = p ? userpcs(p, tf->ebp, s->pcs, 1) : 1;
+	else
+		s->depth = kernpcs(tf->ebp, s->pcs, 1);
+	// The sample must be complete before a reader sees it.
+	asm volatile("" ::: "memory");
+	b->head++;
+}
+
+// Start sampling, discarding old samples, or stop.
+void
+profenable(int on)
+{
+	int i;
+
+	acquire(&proflock);
+	if(on && !profon)
+		for(i = 0; i < ncpu; i++)
+			bufs[i].tail = bufs[i].head;
+	profon = on;
+	release(&proflock);
+}
+
+// Copy up to n samples into buf.  Returns the number copied.
+int
+profread(struct profsample *buf, int n)
+{
+	struct profbuf *b;
+	int i, got;
+
+	got = 0;
+	acquire(&proflock);
+	for(i = 0; i < ncpu && got < n; i++){
+		b = &bufs[i];
+		while(b->tail != b->head && got < n){
+			buf[got++] = b->s[b->tail % NPROF];
+			asm volatile("" ::: "memory");
+			b->tail++;
+		}
+	}
+	release(&proflock);
+	return got;
+}
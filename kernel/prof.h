@@ -0,0 +1,23 @@
+#ifndef PROF_H
+#define PROF_H
+
+// Sampling profiler (see prof.c).
+// Both the kernel and user programs use this header file.
+
+// prof() commands.
+#define PROF_START  1  // discard old samples and start sampling
+#define PROF_STOP   2  // stop sampling
+#define PROF_READ   3  // drain up to n samples into buf
+
+#define NPROFPCS 8     // call chain depth recorded
+
+struct profsample {
+	ushort cpu;
+	ushort depth;        // entries of pcs used
+	int pid;             // 0 if the CPU was in the scheduler
+	char name[16];       // process name, for finding its binary
+	uint pcs[NPROFPCS];  // pcs[0] is the interrupted eip, then return
+	                     // addresses; user ones are below KERNBASE
+};
+
+#endif
@@ -10,9 +10,18 @@
 #include "vm.h"
 #include "shmem_structs.h"
 
-struct shared_memory_object shared_memory_objects_global[GLOBAL_NUMBER_OF_SHM_OBJ];
+// Objects are found by name through a hash table. The registry lock
+// covers the chains and every object's
+// ref_count, so looking a name up and taking a reference is one step.
+// An object's own lock only covers its size, pages and map_count.
+#define SHM_HASH_SIZE 64
+struct {
+    struct spinlock lock;
+    struct shared_memory_object* hash[SHM_HASH_SIZE];
+    int nobjects;                       // objects created so far, for ids
+    volatile uint npages;               // resident pages of all objects
+} shm_registry;
 
-static int initialized = 0;
 int round_up_division(int x, int y){
     int whole_part = x/y;
     if (x%y)
@@ -27,52 +36,11 @@ strcmp(const char *p, const char *q)
 		p++, q++;
 	return (uchar)*p - (uchar)*q;
 }
-char*
 
-strcpy(char *s, const char *t)
-{
-	char *os;
-
-	os = s;
-	while((*s++ = *t++) != 0)
-		;
-	return os;
-}
 
 void init_shared_mem_objects(void){
-    for (int i = 0; i < GLOBAL_NUMBER_OF_SHM_OBJ; i ++){
-        initlock(&shared_memory_objects_global[i].lock, "shm_object_lock");
-        shared_memory_objects_global[i].ref_count = 0;
-        shared_memory_objects_global[i].allocated_pages = -1;
-        shared_memory_objects_global[i].size = 0;
-        shared_memory_objects_global[i].id = i;
-        memset(shared_memory_objects_global[i].name, 0, NAME_SZ);
-    }
-    initialized = 1;
-}
-
-
-int fetch_shared_memory_object(char* name, int* exist){
-    int first_free = -1;
-    for (int i = 0; i < GLOBAL_NUMBER_OF_SHM_OBJ; i++){
-        acquire(&shared_memory_objects_global[i].lock);
-        if (strcmp(name, shared_memory_objects_global[i].name) == 0){
-            *exist = 1;
-            release(&shared_memory_objects_global[i].lock);
-            return i;
-        }
-        if (first_free < 0){
-            if (shared_memory_objects_global[i].name[0] == 0){
-                first_free = i;
-            }
-        }
-        release(&shared_memory_objects_global[i].lock);
-    }
-    if (first_free > -1){
-        return first_free;
-    }
-
-    return -1; // no free object available
+    initlock(&shm_registry.lock, "shm_registry");
+    tracklock(&shm_registry.lock);
 }
 
 int check_if_exists(char* name, struct proc* current_proc){
@@ -99,22 +67,21 @@ int find_free_slot_local(struct proc* current_proc){
     return -1; // no free slot found
 }
 
-int edit_shm_obj(int arr_index, char* name, int exist){
-    acquire(&shared_memory_objects_global[arr_index].lock);
-    if (exist == 0)
-        strcpy(shared_memory_objects_global[arr_index].name, name);
-    shared_memory_objects_global[arr_index].ref_count ++;
-    release(&shared_memory_objects_global[arr_index].lock);
-    return 0;
-}
-
 void unmap(pde_t* pgdir, uint from, uint to){
    // cprintf("Unmap got called \n");
     pte_t* page_table_entry;
     uint adress = PGROUNDDOWN(from);
     for (; adress < to; adress += PGSIZE){
         
+        // a big page goes as a whole, pages of it below from fault back in
+        if (pgdir[PDX(adress)] & PTE_PS)
+            pgdir[PDX(adress)] = 0;
         page_table_entry =  walkpgdir(pgdir, (char*)adress, 0);
+        // pages are faulted in lazily, so whole page tables may be missing
+        if (page_table_entry == 0){
+            adress = PGADDR(PDX(adress) + 1, 0, 0) - PGSIZE;
+            continue;
+        }
         if (*page_table_entry & PTE_P){
             //cprintf("UNMAPED ONE PAGE\n");
             // *page_table_entry &= ~PTE_P;
@@ -122,39 +89,157 @@ void unmap(pde_t* pgdir, uint from, uint to){
             *page_table_entry = 0;
         }
     }
+    tlbflush(pgdir, from, to);
 }
 
-void clean_shm_mem1(struct shared_memory_object* shm_obj){
-    for (int i = 0; i <= shm_obj->allocated_pages; i ++){
-        kfree(shm_obj->memory[i]);
+// returns the radix slot for page number page of the object, allocating
+// the leaf that holds it if alloc is set, caller holds the object lock
+static char** shm_page_slot(struct shared_memory_object* shm_obj, uint page, int alloc){
+    char*** leaf = &shm_obj->memory[page / SHM_LEAF_PAGES];
+    if (*leaf == 0){
+        if (!alloc || (*leaf = (char**)kalloczeroed()) == 0)
+            return 0;
     }
-    shm_obj->allocated_pages = -1;
+    return &(*leaf)[page % SHM_LEAF_PAGES];
+}
+
+// frees every resident page from page number first onwards, along
+// with any leaf left empty, caller must already have unmapped them
+void shm_free_pages(struct shared_memory_object* shm_obj, uint first){
+    for (uint leaf = 0; leaf < SHM_LEAVES; leaf ++){
+        char** pages = shm_obj->memory[leaf];
+        int used = 0;
+        if (pages == 0)
+            continue;
+        for (uint i = 0; i < SHM_LEAF_PAGES; i ++){
+            if (pages[i] == 0)
+                continue;
+            if (leaf * SHM_LEAF_PAGES + i >= first){
+                kfree(pages[i]);
+                pages[i] = 0;
+                fetchadd(&shm_registry.npages, -1);
+            } else
+                used = 1;
+        }
+        if (used && leaf * SHM_LEAF_PAGES + SHM_LEAF_PAGES > first)
+            shm_obj->big[leaf] = 0;
+        if (!used){
+            shm_obj->big[leaf] = 0;
+            kfree((char*)pages);
+            shm_obj->memory[leaf] = 0;
+        }
+    }
+}
+
+// backs leaf with one aligned, zeroed 4 MiB block, if there is one
+static void shm_alloc_big(struct shared_memory_object* shm_obj, uint leaf){
+    char* block;
+    char** slot;
+    if ((block = kalloccontig(SHM_LEAF_PAGES, BIGPGSIZE)) == 0)
+        return;
+    if ((slot = shm_page_slot(shm_obj, leaf * SHM_LEAF_PAGES, 1)) == 0){
+        kfreecontig(block, SHM_LEAF_PAGES);
+        return;
+    }
+    memset(block, 0, BIGPGSIZE);
+    for (uint i = 0; i < SHM_LEAF_PAGES; i ++)
+        slot[i] = block + i * PGSIZE;
+    shm_obj->big[leaf] = 1;
+    fetchadd(&shm_registry.npages, SHM_LEAF_PAGES);
+}
+
+// returns the number of pages backing all objects, for memstat
+uint shm_pages(void){
+    return shm_registry.npages;
+}
+
+void clean_shm_mem1(struct shared_memory_object* shm_obj){
+    shm_free_pages(shm_obj, 0);
 }
 void clean_shared_mem_obj(struct shared_memory_object* shm_obj){
-    shm_obj->ref_count = shm_obj->size = 0;
+    shm_obj->ref_count = shm_obj->size = shm_obj->map_count = 0;
     memset(shm_obj->name, 0, NAME_SZ);
 }
-void clean_local_shared_mem_obj(struct shared_memory_object_local* shm_obj_local, int object_descriptor){
-    struct shared_memory_object** shared_mem_obj = &myproc()->shared_mem_objects[object_descriptor].shared_mem_object;
+void clean_local_shared_mem_obj(struct shared_memory_object_local* shm_obj_local){
     shm_obj_local->virtual_adress = shm_obj_local->flags = 0;
     shm_obj_local->shared_mem_object = 0;
-    (*shared_mem_obj) = 0;
 }
+static uint shm_hash(char* name){
+    uint h = 2166136261;
+    while (*name)
+        h = (h ^ (uchar)*name++) * 16777619;
+    return h % SHM_HASH_SIZE;
+}
+
+// allocates a blank object, caller holds the registry lock
+static struct shared_memory_object* shm_obj_alloc(void){
+    struct shared_memory_object* shm_obj;
+    if ((shm_obj = kmalloc(sizeof(*shm_obj))) == 0)
+        return 0;
+    memset(shm_obj, 0, sizeof(*shm_obj));
+    initlock(&shm_obj->lock, "shm_object_lock");
+    shm_obj->id = shm_registry.nobjects ++;
+    return shm_obj;
+}
+
+// returns the object called name with a new reference, creating it
+// if it does not exist yet
+static struct shared_memory_object* shm_obj_get(char* name){
+    struct shared_memory_object** bucket = &shm_registry.hash[shm_hash(name)];
+    struct shared_memory_object* shm_obj;
+    acquire(&shm_registry.lock);
+    for (shm_obj = *bucket; shm_obj; shm_obj = shm_obj->next)
+        if (strcmp(shm_obj->name, name) == 0)
+            break;
+    if (shm_obj == 0 && (shm_obj = shm_obj_alloc()) != 0){
+        safestrcpy(shm_obj->name, name, NAME_SZ);
+        shm_obj->next = *bucket;
+        *bucket = shm_obj;
+    }
+    if (shm_obj)
+        shm_obj->ref_count ++;
+    release(&shm_registry.lock);
+    return shm_obj;
+}
+
+void shm_obj_dup(struct shared_memory_object* shm_obj){
+    acquire(&shm_registry.lock);
+    shm_obj->ref_count ++;
+    release(&shm_registry.lock);
+}
+
+// drops a reference, the last one unhashes the object and frees it
+// and its pages outside the registry lock
+static void shm_obj_put(struct shared_memory_object* shm_obj){
+    struct shared_memory_object** link;
+    acquire(&shm_registry.lock);
+    if (--shm_obj->ref_count > 0){
+        release(&shm_registry.lock);
+        return;
+    }
+    for (link = &shm_registry.hash[shm_hash(shm_obj->name)]; *link != shm_obj; link = &(*link)->next)
+        ;
+    *link = shm_obj->next;
+    release(&shm_registry.lock);
+
+    clean_shm_mem1(shm_obj);
+    clean_shared_mem_obj(shm_obj);
+    kmfree(shm_obj);
+}
+
 int shm_open(char* name){
     struct proc* current_proc = myproc();
+    // an empty name would look like a free object to the rest of the code
+    if (name[0] == 0 || strlen(name) >= NAME_SZ)
+        return -1;
     int exist = check_if_exists(name, current_proc);
     if (exist < 0){
         int free_slot_local = find_free_slot_local(current_proc);
-        int glob_exist_flag = 0;
-        int global_object_index = fetch_shared_memory_object(name, &glob_exist_flag);
-        // means that either local or global array is full, so no more objects can be added
-        if (free_slot_local < 0 || global_object_index < 0)
+        struct shared_memory_object* shm_obj;
+        // means that either the local slots or memory for a new object ran out
+        if (free_slot_local < 0 || (shm_obj = shm_obj_get(name)) == 0)
             return -1;
-        edit_shm_obj(global_object_index, name, glob_exist_flag);
-        //cprintf("name %s\n", shared_memory_objects_global[global_object_index].name);
-        struct shared_memory_object** shared_mem_obj = &current_proc->shared_mem_objects[free_slot_local].shared_mem_object;
-        *shared_mem_obj = &shared_memory_objects_global[global_object_index];
-        //cprintf("name1: %s\n", current_proc->shared_mem_objects[free_slot_local].shared_mem_object->name);
+        current_proc->shared_mem_objects[free_slot_local].shared_mem_object = shm_obj;
         return  free_slot_local;
     }
     return exist;
@@ -164,72 +249,72 @@ int shm_close_logic(int object_descriptor, struct proc* current_process){
     struct proc* current_proc = (current_process == 0) ? myproc():current_process;
     if (object_descriptor >= LOCAL_NUMBER_OF_SHM_OBJ || object_descriptor < 0)
         return -1;
-    struct shared_memory_object** shared_mem_obj_glob = &current_proc->shared_mem_objects[object_descriptor].shared_mem_object;
-    //struct shared_memory_object_local* = s
-    if (current_proc->shared_mem_objects[object_descriptor].virtual_adress){
+    struct shared_memory_object_local* shm_obj_local = &current_proc->shared_mem_objects[object_descriptor];
+    struct shared_memory_object* shm_obj = shm_obj_local->shared_mem_object;
+    if (shm_obj == 0)
+        return -1;
+    acquire(&shm_obj->lock);
+    if (shm_obj_local->virtual_adress){
         uint oldsz, newsz;
         oldsz = PGROUNDUP(VIRT_SHM_MEM) + (object_descriptor * SHM_OBJ_MAX_SIZE);
-        newsz = oldsz + (*shared_mem_obj_glob)->size;
-        //cprintf("UNMAP GOT CALLED\n");
+        newsz = oldsz + shm_obj->size;
         unmap(current_proc->pgdir, oldsz, newsz);
+        shm_obj->map_count --;
     }
-    acquire(&(*shared_mem_obj_glob)->lock);
-    (*shared_mem_obj_glob)->ref_count --;
-    if ((*shared_mem_obj_glob)->ref_count == 0){
-        clean_shm_mem1((*shared_mem_obj_glob));
-        release(&(*shared_mem_obj_glob)->lock);
-        clean_shared_mem_obj((*shared_mem_obj_glob));
-        clean_local_shared_mem_obj(&current_proc->shared_mem_objects[object_descriptor], object_descriptor);
-        return 1;
-    }
-    release(&(*shared_mem_obj_glob)->lock);
-    clean_local_shared_mem_obj(&current_proc->shared_mem_objects[object_descriptor], object_descriptor);
+    release(&shm_obj->lock);
+    clean_local_shared_mem_obj(shm_obj_local);
+    shm_obj_put(shm_obj);
     return 1;
 }
 int shm_close(int object_descriptor){
     return shm_close_logic(object_descriptor, 0);
 }
 void shm_close_direct(int object_descriptor, struct proc* process){
-    //shm_close_logic(object_descriptor, process);
+    shm_close_logic(object_descriptor, process);
 }
 
+// sets the size of the object, growing or shrinking it. Pages are
+// only allocated when first touched through a mapping (see shm_fault).
+// Shrinking frees pages that other processes might still hold in their
+// page tables and TLBs, so it fails while anyone else has it mapped.
 int shm_trunc(int object_descriptor, int size){
-    //struct shared_memory_object_local* shm_obj_local = &myproc()->shared_mem_objects[object_descriptor];
-    struct shared_memory_object** shared_mem_obj_glob = &myproc()->shared_mem_objects[object_descriptor].shared_mem_object;
-    char* memory;
-    uint pages, new_size, address;
+    struct shared_memory_object_local* shm_obj_local;
+    struct shared_memory_object* shm_obj;
+    struct proc* current_proc = myproc();
+    uint pages, address;
+    char** slot;
     if (object_descriptor >= LOCAL_NUMBER_OF_SHM_OBJ || object_descriptor < 0)
         return -1;
-    if ((*shared_mem_obj_glob) == 0)
+    shm_obj_local = &current_proc->shared_mem_objects[object_descriptor];
+    if ((shm_obj = shm_obj_local->shared_mem_object) == 0)
         return -1;
     pages = round_up_division(size, PGSIZE);
     if (pages > MAX_PAGES || size <= 0)
         return -1;
-    if ((*shared_mem_obj_glob)->size != 0)
-        return -1;
-    //cprintf("Trunc opened with name %s and ref count %d and ID: %d\n", (*shared_mem_obj_glob)->name, (*shared_mem_obj_glob)->ref_count, (*shared_mem_obj_glob)->id);
-    //cprintf("SIZE %d\n", (*shared_mem_obj_glob)->size);
-    acquire(&(*shared_mem_obj_glob)->lock);
     address = PGROUNDUP(VIRT_SHM_MEM) + (object_descriptor * SHM_OBJ_MAX_SIZE);
-    new_size = address + size;
-    for (; address < new_size; address += PGSIZE){
-        memory = kalloc();
-        if (memory == 0){
-            clean_shm_mem1((*shared_mem_obj_glob));
-            release(&(*shared_mem_obj_glob)->lock);
-            return  -1;
+    acquire(&shm_obj->lock);
+    if (size < shm_obj->size){
+        if (shm_obj->map_count > (shm_obj_local->virtual_adress != 0)){
+            release(&shm_obj->lock);
+            return -1;
+        }
+        if (shm_obj_local->virtual_adress){
+            unmap(current_proc->pgdir, address + pages * PGSIZE, address + shm_obj->size);
         }
-        (*shared_mem_obj_glob)->allocated_pages ++;
-        memset(memory, 0, PGSIZE);
-        (*shared_mem_obj_glob)->memory[(*shared_mem_obj_glob)->allocated_pages] = memory;
+        shm_free_pages(shm_obj, pages);
+        // zero the tail of the last page so that growing again reads zeros
+        slot = shm_page_slot(shm_obj, pages - 1, 0);
+        if (size % PGSIZE && slot && *slot)
+            memset(*slot + size % PGSIZE, 0, PGSIZE - size % PGSIZE);
     }
-    (*shared_mem_obj_glob)->size = size;
-    release(&(*shared_mem_obj_glob)->lock);
-    return new_size;
+    shm_obj->size = size;
+    release(&shm_obj->lock);
+    return address + size;
 }
 
+// records the mapping, the pages themselves are installed by shm_fault
 int shm_map(int object_descriptor, void** virtual_adress, int flags){
-    uint address, persistent_address;
+    uint persistent_address;
     struct proc* current_proc = myproc();
     struct shared_memory_object_local* local_shm_obj = &current_proc->shared_mem_objects[object_descriptor];
     struct shared_memory_object** shared_mem_obj_glob = &current_proc->shared_mem_objects[object_descriptor].shared_mem_object;
@@ -237,18 +322,68 @@ int shm_map(int object_descriptor, void** virtual_adress, int flags){
         return -1;
     if (local_shm_obj->virtual_adress != 0 || (*shared_mem_obj_glob) == 0)
         return -1;
-    address = persistent_address = (PGROUNDUP(VIRT_SHM_MEM) + (object_descriptor * SHM_OBJ_MAX_SIZE));
-    for (int i = 0; i <= (*shared_mem_obj_glob)->allocated_pages; i ++){
-        if (mappages(current_proc->pgdir, (char*) address, PGSIZE, V2P((*shared_mem_obj_glob)->memory[i]), flags | PTE_U) < 0){
-            if (i > 0){
-                unmap(current_proc->pgdir, persistent_address, address);
-                return -1;
-            }
-        }
-        address += PGSIZE;
-    }
+    persistent_address = (PGROUNDUP(VIRT_SHM_MEM) + (object_descriptor * SHM_OBJ_MAX_SIZE));
+    acquire(&(*shared_mem_obj_glob)->lock);
+    (*shared_mem_obj_glob)->map_count ++;
+    release(&(*shared_mem_obj_glob)->lock);
     *virtual_adress = (void*) persistent_address;
     local_shm_obj->virtual_adress = persistent_address;
     local_shm_obj->flags = flags;
     return 0;
 }
+
+// handles a page fault at va in the shm window of the current process,
+// allocating the backing page on first touch. Returns -1 if va is not
+// inside a mapped object or the access is not allowed.
+int shm_fault(uint va){
+    struct proc* current_proc = myproc();
+    struct shared_memory_object_local* shm_obj_local;
+    struct shared_memory_object* shm_obj;
+    uint offset, leaf;
+    char** slot;
+    pde_t* pde;
+    pte_t* pte;
+    int object_descriptor;
+    if (va < PGROUNDUP(VIRT_SHM_MEM) || va >= KERNBASE)
+        return -1;
+    object_descriptor = (va - PGROUNDUP(VIRT_SHM_MEM)) / SHM_OBJ_MAX_SIZE;
+    shm_obj_local = &current_proc->shared_mem_objects[object_descriptor];
+    if ((shm_obj = shm_obj_local->shared_mem_object) == 0 || shm_obj_local->virtual_adress == 0)
+        return -1;
+    offset = va - shm_obj_local->virtual_adress;
+    // a fault on a present page is a protection fault
+    pde = &current_proc->pgdir[PDX(va)];
+    pte = walkpgdir(current_proc->pgdir, (char*)va, 0);
+    if ((*pde & PTE_PS) || (pte && (*pte & PTE_P)))
+        return -1;
+    acquire(&shm_obj->lock);
+    if (offset >= shm_obj->size)
+        goto bad;
+    // an untouched 4 MiB stretch lying wholly inside the object gets
+    // one contiguous block, mapped with a single big page while the
+    // page directory slot is free
+    leaf = offset / BIGPGSIZE;
+    if (shm_obj->memory[leaf] == 0 && (leaf + 1) * BIGPGSIZE <= shm_obj->size)
+        shm_alloc_big(shm_obj, leaf);
+    if (shm_obj->big[leaf] && (*pde & PTE_P) == 0){
+        *pde = V2P(shm_obj->memory[leaf][0]) | PTE_PS | PTE_P | (shm_obj_local->flags & PTE_W) | PTE_U;
+        release(&shm_obj->lock);
+        current_proc->minflt ++;
+        return 0;
+    }
+    if ((slot = shm_page_slot(shm_obj, offset / PGSIZE, 1)) == 0)
+        goto bad;
+    if (*slot == 0){
+        if ((*slot = kalloczeroed()) == 0)
+            goto bad;
+        fetchadd(&shm_registry.npages, 1);
+    }
+    if (mappages(current_proc->pgdir, (char*)PGROUNDDOWN(va), PGSIZE, V2P(*slot), (shm_obj_local->flags & PTE_W) | PTE_U) < 0)
+        goto bad;
+    release(&shm_obj->lock);
+    current_proc->minflt ++;
+    return 0;
+bad:
+    release(&shm_obj->lock);
+    return -1;
+}
@@ -15,8 +15,8 @@ int shm_open(char* name);
 // assignes memory to the shared memory object
 // it will page align the size meaning the user might get
 // more memory than they asked for
-// only the first call to this funciton will succseed
-// all subsequent fail
+// later calls grow or shrink the object, pages are allocated
+// lazily when first touched
 int shm_trunc(int object_descriptor, int size);
 // stores the adress of the start of shared memory in virtual adress var
 int shm_map(int object_descriptor, void **virtual_adress, int flags);
@@ -24,7 +24,15 @@ int shm_map(int object_descriptor, void **virtual_adress, int flags);
 // clears the the object if ref reaches 0
 int shm_close(int object_descriptor);
 
+// closes a slot of the given process, used when it exits
 void shm_close_direct(int object_descriptor, struct proc* process);
-//void copy_shm_vm(struct proc* parent, struct proc* child);
+// takes another reference to an object, for fork
+void shm_obj_dup(struct shared_memory_object* shm_obj);
+// installs the page behind a fault in the shm window, 0 on success
+int shm_fault(uint va);
+// frees the object's pages from page number first onwards
+void shm_free_pages(struct shared_memory_object* shm_obj, uint first);
+// pages backing all objects together
+uint shm_pages(void);
 // void fork_proc_clone(struct proc* parrent, struct proc* child);
 #endif
\ No newline at end of file
@@ -1,18 +1,26 @@
 #ifndef SHARED_MEM_STRUC_MODULE
 #define SHARED_MEM_STRUC_MODULE
 #include "spinlock.h"
-#define NAME_SZ 14
-#define GLOBAL_NUMBER_OF_SHM_OBJ 64
+#include "memlayout.h"
+#define NAME_SZ 64
 
-#define MAX_SHM_OBJ_REFS NPROC*LOCAL_NUMBER_OF_SHM_OBJ
+// Pages of an object hang off a two level radix tree: memory[i] is a
+// page of SHM_LEAF_PAGES page pointers. Leaves and pages are allocated
+// on first fault, so size may be far larger than what is resident.
+// A leaf covers exactly 4 MiB, so a leaf backed by one contiguous
+// block can be mapped with a single big page.
+#define SHM_LEAF_PAGES (PAGESIZE / sizeof(char*))
+#define SHM_LEAVES ((MAX_PAGES + SHM_LEAF_PAGES - 1) / SHM_LEAF_PAGES)
 struct shared_memory_object{
     int id;
     struct spinlock lock;
     char name[NAME_SZ];
-    char* memory[32];
-    int ref_count;
-    int allocated_pages;
+    char** memory[SHM_LEAVES];
+    uchar big[SHM_LEAVES];  // leaf's pages are one aligned 4 MiB block
+    int ref_count;  // protected by the registry lock in shmem.c
+    int map_count;  // processes with the object mapped
     uint size;
+    struct shared_memory_object* next;  // hash chain
 };
 
 struct shared_memory_object_local{
@@ -16,18 +16,53 @@ initsleeplock(struct sleeplock *lk, char *name)
 	initlock(&lk->lk, "sleep lock");
 	lk->name = name;
 	lk->locked = 0;
+	lk->readers = 0;
+	lk->writers = 0;
 	lk->pid = 0;
+	lk->owner = 0;
+}
+
+// Busy-wait for an exclusive holder that is running on another
+// CPU, on the bet that it releases sooner than a sleep/wakeup
+// round trip. Called and returns with lk->lk held.
+// Returns 1 if the lock was released while spinning.
+static int
+spinonowner(struct sleeplock *lk)
+{
+	struct proc *owner;
+	int i;
+
+	owner = lk->owner;
+	if(!lk->locked || owner == 0 || owner == myproc() ||
+	   owner->state != RUNNING)
+		return 0;
+
+	release(&lk->lk);
+	for(i = 0; i < SLEEPSPIN; i++){
+		if(*(volatile uint*)&lk->locked == 0 ||
+		   *(volatile struct proc**)&lk->owner != owner ||
+		   *(volatile enum procstate*)&owner->state != RUNNING)
+			break;
+		pause();
+	}
+	acquire(&lk->lk);
+	return !lk->locked;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
 	acquire(&lk->lk);
-	while (lk->locked) {
+	while (lk->locked || lk->readers) {
+		if(spinonowner(lk))
+			continue;
+		lk->writers++;
 		sleep(lk, &lk->lk);
+		lk->writers--;
 	}
 	lk->locked = 1;
 	lk->pid = myproc()->pid;
+	lk->owner = myproc();
 	release(&lk->lk);
 }
 
@@ -37,10 +72,38 @@ releasesleep(struct sleeplock *lk)
 	acquire(&lk->lk);
 	lk->locked = 0;
 	lk->pid = 0;
+	lk->owner = 0;
 	wakeup(lk);
 	release(&lk->lk);
 }
 
+// Acquire lk in shared mode. Any number of processes may hold
+// it shared at once; waits while it is held exclusively or an
+// exclusive acquirer is queued, so writers are not starved.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+	acquire(&lk->lk);
+	while (lk->locked || lk->writers) {
+		if(spinonowner(lk))
+			continue;
+		sleep(lk, &lk->lk);
+	}
+	lk->readers++;
+	release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+	acquire(&lk->lk);
+	if(lk->readers < 1)
+		panic("releasesleepshared");
+	if(--lk->readers == 0)
+		wakeup(lk);
+	release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -51,6 +114,3 @@ holdingsleep(struct sleeplock *lk)
 	release(&lk->lk);
 	return r;
 }
-
-
-
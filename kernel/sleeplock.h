@@ -1,14 +1,19 @@
 #ifndef SLEEP_LOCK_H
 #define SLEEP_LOCK_H
 
-// Long-term locks for processes
+// Long-term locks for processes.
+// Held either exclusively (acquiresleep) or shared by any
+// number of readers (acquiresleepshared).
 struct sleeplock {
-	uint locked;       // Is the lock held?
+	uint locked;       // Is the lock held exclusively?
+	int readers;       // Number of shared holders
+	int writers;       // Exclusive waiters; new readers queue behind them
 	struct spinlock lk; // spinlock protecting this sleep lock
 
 	// For debugging:
 	char *name;        // Name of lock.
 	int pid;           // Process holding lock
+	struct proc *owner; // Process holding lock, for adaptive spinning
 };
 
-#endif
\ No newline at end of file
+#endif
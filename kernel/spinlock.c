@@ -9,37 +9,80 @@
 #include "proc.h"
 #include "spinlock.h"
 
+// Locks whose statistics lockdump() prints.
+static struct {
+	struct spinlock lock;
+	struct spinlock *locks[NLOCKSTAT];
+	int n;
+} lockstat;
+
 void
 initlock(struct spinlock *lk, char *name)
 {
 	lk->name = name;
 	lk->locked = 0;
+	lk->next = 0;
+	lk->owner = 0;
 	lk->cpu = 0;
+	lk->pcs[0] = 0;
+	lk->nacquire = 0;
+	lk->ncontended = 0;
+	lk->spincycles = 0;
+	lk->tracked = 0;
 }
 
 // Acquire the lock.
-// Loops (spins) until the lock is acquired.
+// Takes a ticket and spins until it is served.
 // Holding a lock for a long time may cause
 // other CPUs to waste time spinning to acquire it.
 void
 acquire(struct spinlock *lk)
 {
+	uint ticket;
+	uint64 start;
+	int contended;
+	struct cpu *c;
+
 	pushcli(); // disable interrupts to avoid deadlock.
 	if(holding(lk))
 		panic("acquire");
 
-	// The xchg is atomic.
-	while(xchg(&lk->locked, 1) != 0)
-		;
+	// The xadd is atomic. Each waiter spins reading owner, which
+	// only changes once per release, instead of every waiter
+	// writing the lock word in a loop.
+	ticket = fetchadd(&lk->next, 1);
+	contended = 0;
+	if(*(volatile uint*)&lk->owner != ticket){
+		contended = 1;
+		start = rdtsc();
+		c = mycpu();
+		while(*(volatile uint*)&lk->owner != ticket){
+			// With interrupts off we would never see a
+			// shootdown IPI, and its sender may hold lk.
+			if(c->tlbreq)
+				tlbpoll();
+			pause();
+		}
+		start = rdtsc() - start;
+	}
 
 	// Tell the C compiler and the processor to not move loads or stores
 	// past this point, to ensure that the critical section's memory
 	// references happen after the lock is acquired.
 	__sync_synchronize();
 
+	lk->locked = 1;
+	lk->nacquire++;
+	if(contended){
+		lk->ncontended++;
+		lk->spincycles += start;
+	}
+
 	// Record info about lock acquisition for debugging.
 	lk->cpu = mycpu();
+#ifdef LOCKPCS
 	getcallerpcs(&lk, lk->pcs);
+#endif
 }
 
 // Release the lock.
@@ -59,14 +102,45 @@ release(struct spinlock *lk)
 	// stores; __sync_synchronize() tells them both not to.
 	__sync_synchronize();
 
-	// Release the lock, equivalent to lk->locked = 0.
-	// This code can't use a C assignment, since it might
-	// not be atomic. A real OS would use C atomics here.
-	asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+	lk->locked = 0;
+
+	// Serve the next ticket. Only the holder writes owner, so
+	// a single aligned store is enough to hand the lock over.
+	asm volatile("movl %1, %0" : "+m" (lk->owner) : "r" (lk->owner + 1));
 
 	popcli();
 }
 
+// Add lk to the set of locks reported by lockdump().
+// Meant for long-lived locks; lk must never be freed.
+void
+tracklock(struct spinlock *lk)
+{
+	acquire(&lockstat.lock);
+	if(!lk->tracked && lockstat.n < NLOCKSTAT){
+		lockstat.locks[lockstat.n++] = lk;
+		lk->tracked = 1;
+	}
+	release(&lockstat.lock);
+}
+
+// Print contention statistics of tracked locks to the console.
+// Runs when user types ^T on console.
+// Counters are read without their locks, so they may be slightly stale.
+void
+lockdump(void)
+{
+	struct spinlock *lk;
+	int i;
+
+	cprintf("lock       acquire  contended  spin-kcycles\n");
+	for(i = 0; i < lockstat.n; i++){
+		lk = lockstat.locks[i];
+		cprintf("%s %d %d %d\n", lk->name, lk->nacquire,
+			lk->ncontended, (uint)(lk->spincycles >> 10));
+	}
+}
+
 // Record the current call stack in pcs[] by following the %ebp chain.
 void
 getcallerpcs(void *v, uint pcs[])
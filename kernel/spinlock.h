@@ -2,14 +2,24 @@
 #define SPIN_LOCK_H
 
 // Mutual exclusion lock.
+// Waiters take a ticket from next and spin until owner reaches it,
+// so the lock is handed out in FIFO order.
 struct spinlock {
 	uint locked;       // Is the lock held?
+	uint next;         // Next ticket to hand out.
+	uint owner;        // Ticket now being served.
 
 	// For debugging:
 	char *name;        // Name of lock.
 	struct cpu *cpu;   // The cpu holding the lock.
 	uint pcs[10];      // The call stack (an array of program counters)
-			   // that locked the lock.
+			   // that locked the lock (only with LOCKPCS).
+
+	// Contention statistics, updated by the holder.
+	uint nacquire;     // Number of acquisitions.
+	uint ncontended;   // Acquisitions that had to wait.
+	uint64 spincycles; // rdtsc cycles spent waiting.
+	int tracked;       // On the lockstat list (see tracklock)?
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,272 @@
+// Swapping user pages to disk.
+//
+// mkfs reserves sb.nswap blocks after the file system as swap
+// space, divided into page-sized slots.  When a page allocation
+// for user memory fails, swapout() runs a clock over the process
+// table: it walks the user pages of each process in turn, clearing
+// PTE_A on pages that were used since the last sweep and writing
+// the others to a free slot.  An evicted page's PTE is left not
+// present with PTE_SWAP set and the slot number in the address
+// bits; swapfault() reads it back when the process touches it.
+//
+// A process whose pages are being scanned is kept off the CPUs
+// (see swapgrab), and each eviction is flushed from any TLB that
+// still caches the page table (see tlbflush).  Processes inside a system call are never picked: the
+// kernel may be using their memory with a spin lock held, where a
+// fault could not sleep.  argptr() swaps in its buffer for the
+// same reason.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "vm.h"
+
+#define BPP    (PGSIZE / BSIZE)      // blocks per page
+#define NSLOT  (SWAPBLOCKS / BPP)
+
+#define SWAPSLOT(pte)  (PTE_ADDR(pte) >> PTXSHIFT)
+
+extern struct superblock sb;
+
+struct {
+	struct spinlock lock;   // protects used[] and nfree
+	uchar used[NSLOT];
+	int nslot;              // slots on the disk
+	int nfree;
+
+	struct sleeplock outlock;  // one clock sweep at a time
+	struct proc *hand;      // process the clock stopped in
+	uint va;                // and where
+
+	struct buf buf;         // for page I/O; buf.lock serializes it
+} swap;
+
+void
+swapinit(void)
+{
+	initlock(&swap.lock, "swap");
+	initsleeplock(&swap.outlock, "swapout");
+	initsleeplock(&swap.buf.lock, "swapbuf");
+	swap.nslot = sb.nswap / BPP;
+	if(swap.nslot > NSLOT)
+		swap.nslot = NSLOT;
+	swap.nfree = swap.nslot;
+}
+
+static int
+slotalloc(void)
+{
+	int i;
+
+	acquire(&swap.lock);
+	for(i = 0; i < swap.nslot; i++){
+		if(!swap.used[i]){
+			swap.used[i] = 1;
+			swap.nfree--;
+			release(&swap.lock);
+			return i;
+		}
+	}
+	release(&swap.lock);
+	return -1;
+}
+
+static void
+slotfree(uint slot)
+{
+	acquire(&swap.lock);
+	if(slot >= swap.nslot || !swap.used[slot])
+		panic("slotfree");
+	swap.used[slot] = 0;
+	swap.nfree++;
+	release(&swap.lock);
+}
+
+// Read or write one page of swap, bypassing the buffer cache.
+static void
+swaprw(char *page, uint slot, int write)
+{
+	struct buf *b = &swap.buf;
+	int i;
+
+	acquiresleep(&b->lock);
+	for(i = 0; i < BPP; i++){
+		b->dev = ROOTDEV;
+		b->blockno = sb.swapstart + slot*BPP + i;
+		if(write){
+			memmove(b->data, page + i*BSIZE, BSIZE);
+			b->flags = B_DIRTY;
+		} else
+			b->flags = 0;
+		iderw(b);
+		if(!write)
+			memmove(page + i*BSIZE, b->data, BSIZE);
+	}
+	releasesleep(&b->lock);
+}
+
+// Sweep p's user pages from swap.va, evicting up to n of them.
+// Returns the number evicted, or -1 if swap is full.
+static int
+swapscan(struct proc *p, int n)
+{
+	pte_t *pte;
+	char *mem;
+	int slot, done;
+
+	done = 0;
+	for(; swap.va < p->sz && done < n; swap.va += PGSIZE){
+		// No page table here, or a big page: skip the whole 4 MiB.
+		if((pte = walkpgdir(p->pgdir, (char*)swap.va, 0)) == 0){
+			swap.va = PGADDR(PDX(swap.va) + 1, 0, 0) - PGSIZE;
+			continue;
+		}
+		// The stack guard page has no PTE_U.
+		if((*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+			continue;
+		if(*pte & PTE_A){
+			*pte &= ~PTE_A;
+			continue;
+		}
+		if((slot = slotalloc()) < 0)
+			return done > 0 ? done : -1;
+		mem = P2V(PTE_ADDR(*pte));
+		swaprw(mem, slot, 1);
+		*pte = (slot << PTXSHIFT) | (PTE_FLAGS(*pte) & (PTE_W|PTE_U)) | PTE_SWAP;
+		tlbflush(p->pgdir, swap.va, swap.va + PGSIZE);
+		kfree(mem);
+		p->nswapped++;
+		done++;
+	}
+	return done;
+}
+
+// Push up to n user pages of other processes out to swap.
+// Returns the number of pages freed.  Sleeps, so the caller
+// must not hold a spin lock.
+int
+swapout(int n)
+{
+	struct proc *p, *next;
+	int done, k, wraps, more;
+
+	if(swap.nslot == 0)
+		return 0;
+	acquiresleep(&swap.outlock);
+	done = 0;
+	wraps = 0;
+	p = swap.hand;
+	// Two full laps clear every accessed bit and then evict;
+	// a third is slack for processes that ran in between.
+	while(done < n && wraps < 3){
+		if((p = swapgrab(p, &wraps)) == 0)
+			break;
+		if(p != swap.hand){
+			swap.hand = p;
+			swap.va = 0;
+		}
+		k = swapscan(p, n - done);
+		more = swap.va < p->sz;
+		next = swaprelease(p);
+		if(k < 0)
+			break;
+		done += k;
+		if(!more){
+			// Done with p; the clock moves on.
+			if((p = next) == 0)
+				wraps++;
+			swap.hand = 0;
+		}
+	}
+	releasesleep(&swap.outlock);
+	return done;
+}
+
+// Handle a fault at va in the current process if it hit a page
+// that is out in swap.  Returns 0 if the page is back.
+int
+swapfault(uint va)
+{
+	struct proc *p = myproc();
+	pte_t *pte;
+	char *mem;
+	uint slot;
+
+	if(p == 0 || va >= p->sz)
+		return -1;
+	if((pte = walkpgdir(p->pgdir, (char*)va, 0)) == 0 || !(*pte & PTE_SWAP))
+		return -1;
+	if((mem = kallocuser(0)) == 0)
+		return -1;
+	slot = SWAPSLOT(*pte);
+	swaprw(mem, slot, 0);
+	*pte = V2P(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_P;
+	slotfree(slot);
+	p->majflt++;
+	if(p->nswapped > 0)
+		p->nswapped--;
+	return 0;
+}
+
+// Make sure [va, va+n) of the current process is in memory, for
+// the kernel to use it where it cannot take a fault.
+int
+swapinrange(uint va, uint n)
+{
+	struct proc *p = myproc();
+	pte_t *pte;
+	uint a;
+
+	for(a = PGROUNDDOWN(va); a < va + n && a < p->sz; a += PGSIZE){
+		pte = walkpgdir(p->pgdir, (char*)a, 0);
+		if(pte && (*pte & PTE_SWAP) && swapfault(a) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+// Report the number of swap slots on disk and how many are free.
+void
+swapstat(uint *total, uint *free)
+{
+	acquire(&swap.lock);
+	*total = swap.nslot;
+	*free = swap.nfree;
+	release(&swap.lock);
+}
+
+// Copy the swapped-out page described by pte into mem, for fork.
+void
+swapcopy(pte_t pte, char *mem)
+{
+	swaprw(mem, SWAPSLOT(pte), 0);
+}
+
+// Release the slot of a swapped-out page that is going away.
+void
+swapfree(pte_t pte)
+{
+	slotfree(SWAPSLOT(pte));
+}
+
+// Allocate a page for user memory, zeroed if zero is set.  When
+// memory runs out, evict pages of other processes and try again.
+// Sleeps, so the caller must not hold a spin lock.
+char*
+kallocuser(int zero)
+{
+	char *mem;
+
+	do{
+		if((mem = zero ? kalloczeroed() : kalloc()) != 0)
+			return mem;
+	} while(swapout(SWAPBATCH) > 0);
+	return 0;
+}
@@ -6,6 +6,8 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "trace.h"
+#include "sysstat.h"
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -17,12 +19,7 @@
 int
 fetchint(uint addr, int *ip)
 {
-	struct proc *curproc = myproc();
-
-	if(addr >= curproc->sz || addr+4 > curproc->sz)
-		return -1;
-	*ip = *(int*)(addr);
-	return 0;
+	return copyin(ip, addr, sizeof(*ip));
 }
 
 // Fetch the nul-terminated string at addr from the current process.
@@ -31,18 +28,12 @@ fetchint(uint addr, int *ip)
 int
 fetchstr(uint addr, char **pp)
 {
-	char *s, *ep;
 	struct proc *curproc = myproc();
 
 	if(addr >= curproc->sz)
 		return -1;
 	*pp = (char*)addr;
-	ep = (char*)curproc->sz;
-	for(s = *pp; s < ep; s++){
-		if(*s == 0)
-			return s - *pp;
-	}
-	return -1;
+	return ustrnlen(*pp, curproc->sz - addr);
 }
 
 // Fetch the nth 32-bit system call argument.
@@ -65,6 +56,11 @@ argptr(int n, char **pp, int size)
 		return -1;
 	if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
 		return -1;
+	// The kernel may use the buffer with a spin lock held, where
+	// it cannot fault a swapped-out page back in.  Only worth a
+	// walk of the range if some of our pages went to swap.
+	if(curproc->nswapped && swapinrange(i, size) < 0)
+		return -1;
 	*pp = (char*)i;
 	return 0;
 }
@@ -109,6 +105,17 @@ extern int sys_shm_open(void);
 extern int sys_shm_trunc(void);
 extern int sys_shm_map(void);
 extern int sys_shm_close(void);
+extern int sys_splice(void);
+extern int sys_poll(void);
+extern int sys_fcntl(void);
+extern int sys_aio_setup(void);
+extern int sys_aio_enter(void);
+extern int sys_futex(void);
+extern int sys_memstat(void);
+extern int sys_nanosleep(void);
+extern int sys_trace(void);
+extern int sys_prof(void);
+extern int sys_sysstat(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]      sys_fork,
@@ -138,17 +145,87 @@ static int (*syscalls[])(void) = {
 [SYS_shm_trunc] sys_shm_trunc,
 [SYS_shm_map]   sys_shm_map,
 [SYS_shm_close] sys_shm_close,
+[SYS_splice]    sys_splice,
+[SYS_poll]      sys_poll,
+[SYS_fcntl]     sys_fcntl,
+[SYS_aio_setup] sys_aio_setup,
+[SYS_aio_enter] sys_aio_enter,
+[SYS_futex]     sys_futex,
+[SYS_memstat]   sys_memstat,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_trace]     sys_trace,
+[SYS_prof]      sys_prof,
+[SYS_sysstat]   sys_sysstat,
 };
 
+// Per-CPU statistics, so that counting takes no lock.
+static struct sysstat sysstats[NCPU][NELEM(syscalls)];
+
+// Count a call of num that returned ret after cycles.
+static void
+sysaccount(int num, int ret, uint64 cycles)
+{
+	struct sysstat *s;
+	int b;
+
+	pushcli();
+	s = &sysstats[cpuid()][num];
+	s->calls++;
+	if(ret < 0)
+		s->errors++;
+	s->cycles += cycles;
+	for(b = 0; b < NSYSHIST-1 && (cycles >> (b+1)) != 0; b++)
+		;
+	s->hist[b]++;
+	popcli();
+}
+
+// Sum the statistics of all CPUs into up to n entries of st,
+// indexed by system call number.  Returns the number filled.
+int
+sysstatread(struct sysstat *st, int n)
+{
+	struct sysstat *s;
+	int c, i, b;
+
+	if(n > NELEM(syscalls))
+		n = NELEM(syscalls);
+	memset(st, 0, n*sizeof(*st));
+	for(c = 0; c < ncpu; c++){
+		for(i = 0; i < n; i++){
+			s = &sysstats[c][i];
+			st[i].calls += s->calls;
+			st[i].errors += s->errors;
+			st[i].cycles += s->cycles;
+			for(b = 0; b < NSYSHIST; b++)
+				st[i].hist[b] += s->hist[b];
+		}
+	}
+	return n;
+}
+
+void
+sysstatreset(void)
+{
+	memset(sysstats, 0, sizeof(sysstats));
+}
+
 void
 syscall(void)
 {
 	int num;
+	uint64 start;
 	struct proc *curproc = myproc();
 
 	num = curproc->tf->eax;
 	if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+		traceevent(TR_SYSCALL, num, 0);
+		start = rdtsc();
+		curproc->insyscall = 1;
 		curproc->tf->eax = syscalls[num]();
+		curproc->insyscall = 0;
+		sysaccount(num, curproc->tf->eax, rdtsc() - start);
+		traceevent(TR_SYSRET, num, curproc->tf->eax);
 	} else {
 		cprintf("%d %s: unknown sys call %d\n",
 			curproc->pid, curproc->name, num);
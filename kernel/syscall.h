@@ -1,7 +1,7 @@
 #ifndef SYSTEM_CALLS_H
 #define SYSTEM_CALLS_H
 
-// System call numbers
+// System call numbers; their names are in syscallnames.h.
 #define SYS_fork       1
 #define SYS_exit       2
 #define SYS_wait       3
@@ -29,6 +29,17 @@
 #define SYS_shm_trunc 25
 #define SYS_shm_map   26
 #define SYS_shm_close 27
+#define SYS_splice    28
+#define SYS_poll      29
+#define SYS_fcntl     30
+#define SYS_aio_setup 31
+#define SYS_aio_enter 32
+#define SYS_futex     33
+#define SYS_memstat   34
+#define SYS_nanosleep 35
+#define SYS_trace     36
+#define SYS_prof      37
+#define SYS_sysstat   38
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef SYSCALLNAMES_H
+#define SYSCALLNAMES_H
+
+// System call names, indexed by number, for the user programs and
+// host tools that print them.  Add an entry with each new call.
+
+#include "syscall.h"
+
+static char *syscallnames[] = {
+[SYS_fork]      "fork",
+[SYS_exit]      "exit",
+[SYS_wait]      "wait",
+[SYS_pipe]      "pipe",
+[SYS_read]      "read",
+[SYS_kill]      "kill",
+[SYS_exec]      "exec",
+[SYS_fstat]     "fstat",
+[SYS_chdir]     "chdir",
+[SYS_dup]       "dup",
+[SYS_getpid]    "getpid",
+[SYS_sbrk]      "sbrk",
+[SYS_sleep]     "sleep",
+[SYS_uptime]    "uptime",
+[SYS_open]      "open",
+[SYS_write]     "write",
+[SYS_mknod]     "mknod",
+[SYS_unlink]    "unlink",
+[SYS_link]      "link",
+[SYS_mkdir]     "mkdir",
+[SYS_close]     "close",
+[SYS_getcwd]    "getcwd",
+[SYS_symlink]   "symlink",
+[SYS_shm_open]  "shm_open",
+[SYS_shm_trunc] "shm_trunc",
+[SYS_shm_map]   "shm_map",
+[SYS_shm_close] "shm_close",
+[SYS_splice]    "splice",
+[SYS_poll]      "poll",
+[SYS_fcntl]     "fcntl",
+[SYS_aio_setup] "aio_setup",
+[SYS_aio_enter] "aio_enter",
+[SYS_futex]     "futex",
+[SYS_memstat]   "memstat",
+[SYS_nanosleep] "nanosleep",
+[SYS_trace]     "trace",
+[SYS_prof]      "prof",
+[SYS_sysstat]   "sysstat",
+};
+
+#endif
@@ -9,12 +9,15 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "x86.h"
 #include "proc.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "poll.h"
+#include "timer.h"
 
 #define symlink_depth 10
 
@@ -24,41 +27,73 @@ create(char *path, short type, short major, short minor);
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// A process with an aio worker may have the descriptor closed under
+// it, so then *pf comes with a reference of its own; release the
+// file with fdput() when done.
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
-	
 	int fd;
 	struct file *f;
+	struct proc *p = myproc();
 
 	if(argint(n, &fd) < 0)
 		return -1;
-	if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+	if(fd < 0 || fd >= NOFILE || p->ofile[fd] == 0)
 		return -1;
+	if(pf){
+		if(p->aio == 0)
+			f = p->ofile[fd];
+		else if((f = fdget(p, fd)) == 0)
+			return -1;
+		*pf = f;
+	}
 	if(pfd)
 		*pfd = fd;
-	if(pf)
-		*pf = f;
 	return 0;
 }
 
-// Allocate a file descriptor for the given file.
+// Release a file obtained from argfd().  p->aio only changes in
+// aio_setup, exec and exit, so it is the same as in argfd().
+static void
+fdput(struct file *f)
+{
+	if(myproc()->aio)
+		fileclose(f);
+}
+
+// Allocate a file descriptor in p's table for the given file.
 // Takes over file reference from caller on success.
-static int
-fdalloc(struct file *f)
+// The slot is claimed with cas() because an aio worker may
+// install descriptors while p itself is running.
+int
+fdinstall(struct proc *p, struct file *f)
 {
 	int fd;
-	struct proc *curproc = myproc();
 
 	for(fd = 0; fd < NOFILE; fd++){
-		if(curproc->ofile[fd] == 0){
-			curproc->ofile[fd] = f;
+		if(p->ofile[fd] == 0 && cas((uint*)&p->ofile[fd], 0, (uint)f))
 			return fd;
-		}
 	}
 	return -1;
 }
 
+static int
+fdalloc(struct file *f)
+{
+	return fdinstall(myproc(), f);
+}
+
+// Return a new reference to p's file descriptor fd, or 0.
+// ftable.lock orders this against a concurrent close of fd.
+struct file*
+fdget(struct proc *p, int fd)
+{
+	if(fd < 0 || fd >= NOFILE)
+		return 0;
+	return filedupfd(p->ofile, fd);
+}
+
 int
 sys_dup(void)
 {
@@ -67,9 +102,13 @@ sys_dup(void)
 
 	if(argfd(0, 0, &f) < 0)
 		return -1;
-	if((fd=fdalloc(f)) < 0)
-		return -1;
+	// Take the new descriptor's reference before it is visible.
 	filedup(f);
+	if((fd=fdalloc(f)) < 0){
+		fileclose(f);
+		fd = -1;
+	}
+	fdput(f);
 	return fd;
 }
 
@@ -77,25 +116,33 @@ int
 sys_read(void)
 {
 	struct file *f;
-	int n;
+	int n, r;
 	char *p;
 
-	if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+	if(argfd(0, 0, &f) < 0)
 		return -1;
-	return fileread(f, p, n);
+	r = -1;
+	if(argint(2, &n) >= 0 && argptr(1, &p, n) >= 0)
+		r = fileread(f, p, n);
+	fdput(f);
+	return r;
 }
 
 int
 sys_write(void)
 {
 	struct file *f;
-	int n;
+	int n, r;
 	char *p;
 	// argfd places the file found through its descriptor into the f struct
 	// the argfd pops off arguments form the user arguments stack, or whatever it is called
-	if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+	if(argfd(0, 0, &f) < 0)
 		return -1;
-	return filewrite(f, p, n);
+	r = -1;
+	if(argint(2, &n) >= 0 && argptr(1, &p, n) >= 0)
+		r = filewrite(f, p, n);
+	fdput(f);
+	return r;
 }
 
 int
@@ -104,9 +151,11 @@ sys_close(void)
 	int fd;
 	struct file *f;
 
-	if(argfd(0, &fd, &f) < 0)
+	if(argfd(0, &fd, 0) < 0)
+		return -1;
+	// Claim the slot atomically; an aio close may race with us.
+	if((f = (struct file*)xchg((uint*)&myproc()->ofile[fd], 0)) == 0)
 		return -1;
-	myproc()->ofile[fd] = 0;
 	fileclose(f);
 	return 0;
 }
@@ -116,10 +165,15 @@ sys_fstat(void)
 {
 	struct file *f;
 	struct stat *st;
+	int r;
 
-	if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+	if(argfd(0, 0, &f) < 0)
 		return -1;
-	return filestat(f, st);
+	r = -1;
+	if(argptr(1, (void*)&st, sizeof(*st)) >= 0)
+		r = filestat(f, st);
+	fdput(f);
+	return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -422,17 +476,14 @@ int follow_link(struct inode* inode_, char* name, int count_param, int* ret_coun
     return 1;
 }
 
-int
-sys_open(void)
+// Open path with the O_* flags in omode and return a new open
+// file, or 0.  Shared by sys_open and the aio worker.
+struct file*
+fileopen(char *path, int omode)
 {
-	char *path;
-	int fd, omode;
 	struct file *f;
 	struct inode *ip;
 
-	if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
-		return -1;
-
 	begin_op();
 
 	if(omode & O_CREATE){
@@ -457,7 +508,7 @@ sys_open(void)
 					if (counter == 10){
 						// return error
 						end_op();
-                		return -1;
+                		return 0;
 					}
 					ip = create(name, T_FILE, 0, 0);
 				}
@@ -477,20 +528,20 @@ sys_open(void)
 		if(ip == 0){
 			// this means that one of the create statements failed, and the operation cannot proceed.
 			end_op();
-			return -1;
+			return 0;
 		}
 	} else {
 		if((ip = namei(path)) == 0){
 			end_op();
-			return -1;
+			return 0;
 		}
         // locks for acess in if, since namei returns unlocked
 		ilock(ip);
-		if(ip->type == T_DIR && (omode != O_RDONLY && omode != O_NOFOLLOW)){
+		if(ip->type == T_DIR && ((omode & ~O_NONBLOCK) != O_RDONLY && (omode & ~O_NONBLOCK) != O_NOFOLLOW)){
 			// unlocks since it was locked before if
             iunlockput(ip);
 			end_op();
-			return -1;
+			return 0;
 		}
         // ip is still locked if this if gets evaluated
         if (ip->type == T_SYMLINK && !(omode & O_NOFOLLOW)){
@@ -498,18 +549,16 @@ sys_open(void)
             if (follow_link(ip, name, symlink_depth, NULL) < 0){
                 // If the code above errors the inode is already unlocked, so uloncking it here would cause a kermel panic
                 end_op();
-                return -1;
+                return 0;
             }
         }
 	}
 
-	// allocate file and a corresponding descriptor as a handle to the open file
-	if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
-		if(f)
-			fileclose(f);
+	// allocate an open file as a handle to the inode
+	if((f = filealloc()) == 0){
 		iunlockput(ip);
 		end_op();
-		return -1;
+		return 0;
 	}
     if (ip->type == T_SYMLINK){
 		f->writable = 0;
@@ -525,14 +574,34 @@ sys_open(void)
 	f->ip = ip;
 	f->off = 0;
 	f->readable = !(omode & O_WRONLY);
+	f->nonblock = (omode & O_NONBLOCK) != 0;
 	//f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
-	return fd;
+	return f;
 	// returns file descriptor which despite the name may refer to directories and many other things as well
 	// The file descriptor links to an open file description, an entry in the system wide table of open files
 
 	// for more information https://www.man7.org/linux/man-pages/man2/open.2.html#DESCRIPTION
 }
 
+int
+sys_open(void)
+{
+	char *path;
+	int fd, omode;
+	struct file *f;
+
+	if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
+		return -1;
+	if((f = fileopen(path, omode)) == 0)
+		return -1;
+	// allocate a descriptor as a handle to the open file
+	if((fd = fdalloc(f)) < 0){
+		fileclose(f);
+		return -1;
+	}
+	return fd;
+}
+
 int
 sys_mkdir(void)
 {
@@ -573,7 +642,7 @@ int
 sys_chdir(void)
 {
 	char *path;
-	struct inode *ip;
+	struct inode *ip, *old;
 	struct proc *curproc = myproc();
 
 	begin_op();
@@ -603,9 +672,13 @@ sys_chdir(void)
 	}
 	
 	iunlock(ip);
-	iput(curproc->cwd);
+	old = curproc->cwd;
+	if(curproc->aio)
+		aiochdir(curproc, ip);
+	else
+		curproc->cwd = ip;
+	iput(old);
 	end_op();
-	curproc->cwd = ip;
 	return 0;
 }
 
@@ -659,6 +732,157 @@ sys_pipe(void)
 	return 0;
 }
 
+// Move up to n bytes from fd_in to fd_out without copying
+// through user space. One of the two must be a pipe.
+int
+sys_splice(void)
+{
+	struct file *in, *out;
+	int n, r;
+
+	if(argfd(0, 0, &in) < 0)
+		return -1;
+	if(argfd(1, 0, &out) < 0){
+		fdput(in);
+		return -1;
+	}
+	r = -1;
+	if(argint(2, &n) < 0 || n < 0 || in->readable == 0 || out->writable == 0)
+		goto out;
+	if(in->type == FD_PIPE && out->type == FD_PIPE && in->pipe == out->pipe)
+		goto out;
+	if(in->type == FD_PIPE)
+		r = pipespliceout(in->pipe, out, n);
+	else if(out->type == FD_PIPE)
+		r = pipesplicein(out->pipe, in, n);
+out:
+	fdput(in);
+	fdput(out);
+	return r;
+}
+
+// Get or set the O_NONBLOCK flag of an open file.
+int
+sys_fcntl(void)
+{
+	struct file *f;
+	int cmd, arg, r;
+
+	if(argfd(0, 0, &f) < 0)
+		return -1;
+	r = -1;
+	if(argint(1, &cmd) >= 0 && argint(2, &arg) >= 0){
+		switch(cmd){
+		case F_GETFL:
+			r = f->nonblock ? O_NONBLOCK : 0;
+			break;
+		case F_SETFL:
+			f->nonblock = (arg & O_NONBLOCK) != 0;
+			r = 0;
+			break;
+		}
+	}
+	fdput(f);
+	return r;
+}
+
+// Fill in revents for each of the nfds entries of fds and return
+// how many are non-zero.  files[i] is the file open on fds[i].fd,
+// or 0.  With how == WQ_ADD or WQ_DEL also register or unregister
+// the caller on each underlying object.
+static int
+pollscan(struct pollfd *fds, struct file **files, int nfds, int how)
+{
+	int i, n, r;
+
+	n = 0;
+	for(i = 0; i < nfds; i++){
+		r = 0;
+		if(fds[i].fd >= 0){
+			if(files[i] == 0)
+				r = POLLNVAL;
+			else
+				r = filepoll(files[i], how) & (fds[i].events|POLLERR|POLLHUP|POLLNVAL);
+		}
+		if(how != WQ_DEL)
+			fds[i].revents = r;
+		if(r)
+			n++;
+	}
+	return n;
+}
+
+// Wait for one of the nfds descriptors in fds to become ready.
+// timeout is in clock ticks; -1 waits forever, 0 never waits.
+// Returns the number of ready descriptors, 0 on timeout.
+// The descriptors and the user's array can change while we
+// sleep (an aio worker may close an fd or read into fds), so
+// work on a copy and on the files looked up once at the start:
+// those are the ones we are on the wait queues of.
+int
+sys_poll(void)
+{
+	struct pollfd *ufds, fds[NPOLLFD];
+	struct file *files[NPOLLFD];
+	int i, nfds, timeout, n;
+	struct timer t;
+	struct proc *curproc = myproc();
+
+	if(argint(1, &nfds) < 0 || argint(2, &timeout) < 0)
+		return -1;
+	if(nfds < 0 || nfds > NPOLLFD)
+		return -1;
+	if(argptr(0, (void*)&ufds, nfds*sizeof(*ufds)) < 0)
+		return -1;
+	memmove(fds, ufds, nfds*sizeof(*fds));
+	for(i = 0; i < nfds; i++)
+		files[i] = fds[i].fd >= 0 ? fdget(curproc, fds[i].fd) : 0;
+
+	if(timeout > 0)
+		timeradd(&t, tickdeadline(timeout), &curproc->pollev);
+	for(;;){
+		// Any wakeup after this point makes pollsleep() return.
+		curproc->pollev = 0;
+		n = pollscan(fds, files, nfds, timeout == 0 ? WQ_NONE : WQ_ADD);
+		if(n > 0 || timeout == 0 || curproc->killed)
+			break;
+		if(timeout > 0 && t.fired)
+			break;
+		pollsleep(timeout > 0 ? &t : 0);
+	}
+	if(timeout > 0)
+		timerdel(&t);
+	if(timeout != 0)
+		pollscan(fds, files, nfds, WQ_DEL);
+	for(i = 0; i < nfds; i++)
+		if(files[i])
+			fileclose(files[i]);
+	if(curproc->killed)
+		return -1;
+	// Fetch the pointer again in case the array went to swap.
+	if(argptr(0, (void*)&ufds, nfds*sizeof(*ufds)) < 0)
+		return -1;
+	for(i = 0; i < nfds; i++)
+		ufds[i].revents = fds[i].revents;
+	return n;
+}
+
 int sys_getcwd(void){
 	
-}
\ No newline at end of file
+}
+
+int
+sys_aio_setup(void)
+{
+	return aiosetup();
+}
+
+int
+sys_aio_enter(void)
+{
+	int min;
+
+	if(argint(0, &min) < 0)
+		return -1;
+	return aioenter(min);
+}
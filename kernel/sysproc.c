@@ -7,6 +7,12 @@
 #include "mmu.h"
 #include "proc.h"
 #include "shmem.h"
+#include "futex.h"
+#include "fs.h"
+#include "memstat.h"
+#include "trace.h"
+#include "prof.h"
+#include "sysstat.h"
 
 int
 sys_fork(void)
@@ -61,21 +67,147 @@ int
 sys_sleep(void)
 {
 	int n;
-	uint ticks0;
 
 	if(argint(0, &n) < 0)
 		return -1;
-	acquire(&tickslock);
-	ticks0 = ticks;
-	while(ticks - ticks0 < n){
-		if(myproc()->killed){
-			release(&tickslock);
+	if(myproc()->killed)
+		return -1;
+	if(n <= 0)
+		return 0;
+	return tsleep(tickdeadline(n));
+}
+
+// Sleep for sec seconds and nsec nanoseconds, timed by the TSC
+// rather than the clock tick.
+int
+sys_nanosleep(void)
+{
+	int sec, nsec;
+
+	if(argint(0, &sec) < 0 || argint(1, &nsec) < 0)
+		return -1;
+	if(sec < 0 || nsec < 0 || nsec >= 1000000000)
+		return -1;
+	return tsleep(timedeadline(sec, nsec));
+}
+
+// Wait on or wake a word of user memory, usually in a shm object
+// that other processes map too.
+int
+sys_futex(void)
+{
+	int addr, op, val;
+	char *page;
+	uint *kaddr;
+
+	if(argint(0, &addr) < 0 || argint(1, &op) < 0 || argint(2, &val) < 0)
+		return -1;
+	if(addr % sizeof(uint) != 0)
+		return -1;
+	if((page = uva2ka(myproc()->pgdir, (char*)PGROUNDDOWN((uint)addr))) == 0)
+		return -1;
+	kaddr = (uint*)(page + (uint)addr % PGSIZE);
+
+	switch(op){
+	case FUTEX_WAIT:
+		return futexwait(kaddr, val);
+	case FUTEX_WAKE:
+		futexwake(kaddr);
+		return 0;
+	}
+	return -1;
+}
+
+// Report physical memory use, globally and per process.
+int
+sys_memstat(void)
+{
+	struct memstat *ms;
+	struct procmem *pm;
+	int n;
+
+	if(argint(2, &n) < 0 || n < 0 || n > KERNBASE/sizeof(*pm))
+		return -1;
+	if(argptr(0, (char**)&ms, sizeof(*ms)) < 0 ||
+	   argptr(1, (char**)&pm, n*sizeof(*pm)) < 0)
+		return -1;
+	kmemstat(ms);
+	ms->slab = kmpages();
+	ms->shm = shm_pages();
+	ms->bcache = (NBUF*BSIZE + PGSIZE-1) / PGSIZE;
+	swapstat(&ms->swaptotal, &ms->swapfree);
+	return procmem(pm, n);
+}
+
+// Turn event tracing on or off, or drain recorded events.
+int
+sys_trace(void)
+{
+	struct traceev *buf;
+	int cmd, n;
+
+	if(argint(0, &cmd) < 0)
+		return -1;
+	switch(cmd){
+	case TRACE_ON:
+	case TRACE_OFF:
+		traceenable(cmd == TRACE_ON);
+		return 0;
+	case TRACE_READ:
+		if(argint(2, &n) < 0 || n < 0 || n > KERNBASE/sizeof(*buf))
+			return -1;
+		if(argptr(1, (char**)&buf, n*sizeof(*buf)) < 0)
 			return -1;
-		}
-		sleep(&ticks, &tickslock);
+		return traceread(buf, n);
 	}
-	release(&tickslock);
-	return 0;
+	return -1;
+}
+
+// Start or stop the sampling profiler, or drain its samples.
+int
+sys_prof(void)
+{
+	struct profsample *buf;
+	int cmd, n;
+
+	if(argint(0, &cmd) < 0)
+		return -1;
+	switch(cmd){
+	case PROF_START:
+	case PROF_STOP:
+		profenable(cmd == PROF_START);
+		return 0;
+	case PROF_READ:
+		if(argint(2, &n) < 0 || n < 0 || n > KERNBASE/sizeof(*buf))
+			return -1;
+		if(argptr(1, (char**)&buf, n*sizeof(*buf)) < 0)
+			return -1;
+		return profread(buf, n);
+	}
+	return -1;
+}
+
+// Read or reset the system call statistics.
+int
+sys_sysstat(void)
+{
+	struct sysstat *buf;
+	int cmd, n;
+
+	if(argint(0, &cmd) < 0)
+		return -1;
+	switch(cmd){
+	case SYSSTAT_READ:
+		if(argint(2, &n) < 0 || n < 0 || n > KERNBASE/sizeof(*buf))
+			return -1;
+		if(argptr(1, (char**)&buf, n*sizeof(*buf)) < 0)
+			return -1;
+		return sysstatread(buf, n);
+	case SYSSTAT_RESET:
+		sysstatreset();
+		return 0;
+	}
+	return -1;
 }
 
 // return how many clock tick interrupts have occurred
@@ -97,9 +229,6 @@ int sys_shm_open(void){
 	//pointer to a string
 	if(argstr(0, &name) < 0)
 		return -1;
-	if (name[0] == 0)
-        return -1;
-	
 	return shm_open(name);
 }
 
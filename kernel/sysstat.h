@@ -0,0 +1,21 @@
+#ifndef SYSSTAT_H
+#define SYSSTAT_H
+
+// System call statistics (see syscall.c).
+// Both the kernel and user programs use this header file.
+
+// sysstat() commands.
+#define SYSSTAT_READ   1  // sum the statistics of every CPU into buf
+#define SYSSTAT_RESET  2  // zero them
+
+#define NSYSHIST 32       // latency buckets
+
+// One system call.  exit never returns, so it is never counted.
+struct sysstat {
+	uint calls;
+	uint errors;           // calls that returned a negative value
+	uint64 cycles;         // rdtsc cycles spent in the call
+	uint hist[NSYSHIST];   // hist[i]: calls taking [2^i, 2^(i+1)) cycles
+};
+
+#endif
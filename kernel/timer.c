@@ -0,0 +1,183 @@
+// Clock ticks and the timer queue.
+//
+// Each CPU's LAPIC timer is one-shot, programmed for that CPU's
+// next deadline in TSC cycles (see lapictimer).  A CPU that runs
+// processes stops at every clock tick, HZ times a second, which
+// preempts the process.  An idle CPU stops only for the first
+// timer on the queue; with none queued it stays in hlt() until
+// some other interrupt or a wakeup IPI (see kickidle).
+//
+// Ticks are TSC time rounded to the tick: whichever CPU takes a
+// timer interrupt catches ticks up with the TSC and fires the
+// timers that are due.  A CPU leaving idle does the same before it
+// runs anything, so running code never sees a stale ticks.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "timer.h"
+
+// Protected by tickslock, like ticks.
+static uint64 nexttick;        // TSC time of the next tick
+static struct timer *timerq;   // pending timers, soonest first
+
+void
+timerinit(void)
+{
+	nexttick = rdtsc() + tickcycles;
+}
+
+// Bring ticks up to date and fire the timers that are due.
+// Caller holds tickslock.
+static void
+timeradvance(void)
+{
+	struct timer *t;
+	uint64 now;
+
+	now = rdtsc();
+	if(now >= nexttick){
+		do{
+			ticks++;
+			nexttick += tickcycles;
+		} while(now >= nexttick);
+		kinfotick();
+		wakeup(&ticks);
+	}
+	while((t = timerq) != 0 && t->when <= now){
+		timerq = t->next;
+		t->fired = 1;
+		wakeup(t->chan);
+	}
+}
+
+// Program this CPU's timer for its next deadline: the first
+// queued timer and, if the CPU is running processes, the next
+// tick.  Caller holds tickslock.
+static void
+timerarm(void)
+{
+	uint64 when, now;
+
+	when = mycpu()->ticking ? nexttick : 0;
+	if(timerq && (when == 0 || timerq->when < when))
+		when = timerq->when;
+	if(when == 0){
+		lapictimer(0);
+		return;
+	}
+	now = rdtsc();
+	lapictimer(when > now ? when - now : 1);
+}
+
+// Timer interrupt.
+void
+timerintr(void)
+{
+	acquire(&tickslock);
+	timeradvance();
+	timerarm();
+	release(&tickslock);
+}
+
+// This CPU is about to halt: stop ticking.  Interrupts are off.
+void
+timeridle(void)
+{
+	acquire(&tickslock);
+	mycpu()->ticking = 0;
+	timerarm();
+	release(&tickslock);
+}
+
+// This CPU may run processes: tick again.
+void
+timerbusy(void)
+{
+	acquire(&tickslock);
+	mycpu()->ticking = 1;
+	timeradvance();
+	timerarm();
+	release(&tickslock);
+}
+
+// Queue t to fire at TSC time when and wake chan.
+void
+timeradd(struct timer *t, uint64 when, void *chan)
+{
+	struct timer **pp;
+
+	t->when = when;
+	t->chan = chan;
+	t->fired = 0;
+	acquire(&tickslock);
+	for(pp = &timerq; *pp && (*pp)->when <= when; pp = &(*pp)->next)
+		;
+	t->next = *pp;
+	*pp = t;
+	// Some CPU must stop in time for t; let it be this one.
+	timerarm();
+	release(&tickslock);
+}
+
+// Take t off the queue if it has not fired.
+void
+timerdel(struct timer *t)
+{
+	struct timer **pp;
+
+	acquire(&tickslock);
+	if(!t->fired){
+		for(pp = &timerq; *pp != t; pp = &(*pp)->next)
+			;
+		*pp = t->next;
+	}
+	release(&tickslock);
+}
+
+// TSC time of the n'th clock tick from now.
+uint64
+tickdeadline(int n)
+{
+	uint64 when;
+
+	acquire(&tickslock);
+	timeradvance();
+	when = nexttick + (uint64)(n - 1) * tickcycles;
+	release(&tickslock);
+	return when;
+}
+
+// TSC time sec seconds and nsec nanoseconds from now.
+uint64
+timedeadline(uint sec, uint nsec)
+{
+	uint perus;
+
+	perus = tickcycles / (1000000 / HZ);
+	return rdtsc() + (uint64)sec * HZ * tickcycles +
+		(uint64)(nsec / 1000) * perus + (nsec % 1000) * perus / 1000;
+}
+
+// Sleep until TSC time when.  Returns -1 if killed first.
+int
+tsleep(uint64 when)
+{
+	struct timer t;
+
+	timeradd(&t, when, &t);
+	acquire(&tickslock);
+	while(!t.fired && !myproc()->killed)
+		sleep(&t, &tickslock);
+	release(&tickslock);
+	if(!t.fired){
+		timerdel(&t);
+		return -1;
+	}
+	return 0;
+}
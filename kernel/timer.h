@@ -0,0 +1,14 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// An entry on the timer queue (see timer.c).  When the TSC reaches
+// when, the timer is taken off the queue, fired is set, and
+// whatever sleeps on chan is woken.
+struct timer {
+	uint64 when;
+	void *chan;
+	volatile int fired;
+	struct timer *next;
+};
+
+#endif
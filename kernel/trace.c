@@ -0,0 +1,106 @@
+// Kernel event tracing.
+//
+// Each CPU records events into a ring of its own, with interrupts
+// off, so recording takes no lock.  When a ring is full the oldest
+// events are overwritten.  trace(TRACE_READ) drains the rings; a
+// reader that falls more than a ring behind skips what was lost,
+// and rechecks each event after copying it in case the CPU lapped
+// it meanwhile.  user/trace.c prints what it drains, and
+// tools/trace2json.c turns that into a Chrome trace.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "trace.h"
+
+struct tracering {
+	volatile uint head;  // events recorded; the next goes in ev[head % NTRACE]
+	uint tail;           // events drained
+	struct traceev ev[NTRACE];
+};
+
+static struct tracering rings[NCPU];
+static struct spinlock tracelock;  // one reader at a time
+static volatile int traceon;
+
+void
+traceinit(void)
+{
+	initlock(&tracelock, "trace");
+}
+
+// Record an event on this CPU, if tracing is on.
+void
+traceevent(int type, uint a0, uint a1)
+{
+	struct tracering *r;
+	struct traceev *e;
+	struct cpu *c;
+
+	if(!traceon)
+		return;
+	pushcli();
+	c = mycpu();
+	r = &rings[c - cpus];
+	e = &r->ev[r->head % NTRACE];
+	e->tsc = rdtsc();
+	e->type = type;
+	e->cpu = c - cpus;
+	e->pid = c->proc ? c->proc->pid : 0;
+	e->a0 = a0;
+	e->a1 = a1;
+	// The event must be complete before a reader sees it.
+	asm volatile("" ::: "memory");
+	r->head++;
+	popcli();
+}
+
+// Copy up to n events into buf.  Returns the number copied.
+int
+traceread(struct traceev *buf, int n)
+{
+	struct tracering *r;
+	struct traceev e;
+	int i, got;
+
+	got = 0;
+	acquire(&tracelock);
+	for(i = 0; i < ncpu && got < n; i++){
+		r = &rings[i];
+		while(r->tail != r->head && got < n){
+			if(r->head - r->tail > NTRACE){
+				r->tail = r->head - NTRACE;
+				continue;
+			}
+			e = r->ev[r->tail % NTRACE];
+			asm volatile("" ::: "memory");
+			if(r->head - r->tail >= NTRACE){
+				// Overwritten while we copied it.
+				r->tail++;
+				continue;
+			}
+			buf[got++] = e;
+			r->tail++;
+		}
+	}
+	release(&tracelock);
+	return got;
+}
+
+// Start recording, discarding old events, or stop.
+void
+traceenable(int on)
+{
+	int i;
+
+	acquire(&tracelock);
+	if(on && !traceon)
+		for(i = 0; i < ncpu; i++)
+			rings[i].tail = rings[i].head;
+	traceon = on;
+	release(&tracelock);
+}
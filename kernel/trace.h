@@ -0,0 +1,34 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Kernel event tracing (see trace.c).
+// Both the kernel and user programs use this header file.
+
+// trace() commands.
+#define TRACE_ON    1  // discard old events and start recording
+#define TRACE_OFF   2  // stop recording
+#define TRACE_READ  3  // drain up to n events into buf
+
+// Event types, and what a0 and a1 hold.
+#define TR_SYSCALL     1  // a0 = system call number
+#define TR_SYSRET      2  // a0 = system call number, a1 = return value
+#define TR_SWITCHIN    3  // a0 = pid now running on the CPU
+#define TR_SWITCHOUT   4  // a0 = pid leaving the CPU, a1 = its new state
+#define TR_DISKSTART   5  // a0 = block number, a1 = 1 for a write
+#define TR_DISKDONE    6  // a0 = block number
+#define TR_BGETHIT     7  // a0 = block number
+#define TR_BGETMISS    8  // a0 = block number
+#define TR_COMMIT      9  // a0 = blocks in the transaction
+#define TR_COMMITDONE 10
+#define TR_PGFLT      11  // a0 = faulting address, a1 = error code
+
+struct traceev {
+	uint64 tsc;     // rdtsc when it happened
+	ushort type;
+	ushort cpu;
+	int pid;        // process on the CPU, 0 if none
+	uint a0;
+	uint a1;
+};
+
+#endif
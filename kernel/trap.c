@@ -7,12 +7,17 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "shmem.h"
+#include "trace.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
+int sysenterok;  // CPUs have sysenter, and its MSRs are set up
+
+#define SYSENTER_OP 0x340f  // 0f 34, as a little-endian ushort
 
 void
 tvinit(void)
@@ -32,9 +37,46 @@ idtinit(void)
 	lidt(idt, sizeof(idt));
 }
 
+// Point this CPU's sysenter at sysentry.  The stack pointer
+// MSR changes with the process; switchuvm sets it.
+void
+sysenterinit(void)
+{
+	extern char sysentry[];
+	uint edx;
+
+	x86cpuid(1, 0, 0, 0, &edx);
+	if(!(edx & (1 << 11)))  // SEP: sysenter/sysexit
+		return;
+	wrmsr(MSR_SYSENTER_CS, SEG_KCODE<<3);
+	wrmsr(MSR_SYSENTER_EIP, (uint)sysentry);
+	sysenterok = 1;
+}
+
 void
 trap(struct trapframe *tf)
 {
+	extern char sysentry[], sysentrytf[];
+	uint fix;
+	ushort op;
+
+	// sysenter with the user's TF set single-steps into sysentry.
+	// Carry on there without TF; sysentrytf puts it in the frame.
+	if(tf->trapno == T_DEBUG && (tf->cs&3) == 0 &&
+	   tf->eip == (uint)sysentry){
+		tf->eflags &= ~FL_TF;
+		tf->eip = (uint)sysentrytf;
+		return;
+	}
+
+	// A CPU without sysenter faults on the one in usys.S; treat it
+	// as the int $T_SYSCALL it stands for.
+	if(tf->trapno == T_ILLOP && (tf->cs&3) == DPL_USER &&
+	   copyin(&op, tf->eip, sizeof(op)) == 0 && op == SYSENTER_OP){
+		tf->trapno = T_SYSCALL;
+		tf->eip = tf->edx;
+		tf->esp = tf->ecx;
+	}
 	if(tf->trapno == T_SYSCALL){
 		if(myproc()->killed)
 			exit();
@@ -47,12 +89,16 @@ trap(struct trapframe *tf)
 
 	switch(tf->trapno){
 	case T_IRQ0 + IRQ_TIMER:
-		if(cpuid() == 0){
-			acquire(&tickslock);
-			ticks++;
-			wakeup(&ticks);
-			release(&tickslock);
-		}
+		profsample(tf);
+		timerintr();
+		lapiceoi();
+		break;
+	case T_TLBFLUSH:
+		tlbpoll();
+		lapiceoi();
+		break;
+	case T_WAKEUP:
+		// Only here to end the hlt in scheduler().
 		lapiceoi();
 		break;
 	case T_IRQ0 + IRQ_IDE:
@@ -76,6 +122,29 @@ trap(struct trapframe *tf)
 			cpuid(), tf->cs, tf->eip);
 		lapiceoi();
 		break;
+	case T_PGFLT:
+		traceevent(TR_PGFLT, rcr2(), tf->err);
+		// Shared memory is faulted in on first touch, and
+		// swapped-out pages come back when touched.
+		if(myproc() && (tf->cs&3) == DPL_USER){
+			if(shm_fault(rcr2()) == 0 || swapfault(rcr2()) == 0)
+				break;
+			// Maybe there was no memory for a shm page.
+			if(rcr2() >= VIRT_SHM_MEM && swapout(SWAPBATCH) > 0 &&
+			   shm_fault(rcr2()) == 0)
+				break;
+		}
+		// The kernel may touch a swapped-out user page too, as
+		// long as it holds no spin lock and so may sleep.
+		if(myproc() && (tf->cs&3) == 0 && mycpu()->ncli == 0 &&
+		   swapfault(rcr2()) == 0)
+			break;
+		// Otherwise a user copy fails instead of the kernel.
+		if((tf->cs&3) == 0 && (fix = extablefind(tf->eip)) != 0){
+			tf->eip = fix;
+			break;
+		}
+		// fall through
 
 	default:
 		if(myproc() == 0 || (tf->cs&3) == 0){
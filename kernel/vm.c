@@ -6,6 +6,7 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "traps.h"
 #include "shmem.h"
 
 extern char data[];  // defined by kernel.ld
@@ -32,7 +33,9 @@ seginit(void)
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
-// create any required page table pages.
+// create any required page table pages.  A 4 MiB (PTE_PS)
+// mapping has no PTE, so va inside one yields 0; callers
+// that can meet big pages check the PDE themselves.
 pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
@@ -45,6 +48,8 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 	it has 1024 entries of 32 bits, coresponding to 4 KiB
 	*/
 	pde = &pgdir[PDX(va)];
+	if(*pde & PTE_PS)
+		return 0;
 	if(*pde & PTE_P){
 		// finds the page table in the page directory by indexing into the page directory
 		// if the page table is present indicated by the PTE_P flag, it puts the page table
@@ -54,10 +59,9 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 		pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
 		//line over takes the physical adress from pde maps it to a virtual adress and puts it in pgtab
 	} else {
-		if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
-			return 0;
 		// Make sure all those PTE_P bits are zero.
-		memset(pgtab, 0, PGSIZE);
+		if(!alloc || (pgtab = (pte_t*)kalloczeroed()) == 0)
+			return 0;
 		// The permissions here are overly generous, but they can
 		// be further restricted by the permissions in the page table
 		// entries, if necessary.
@@ -142,9 +146,8 @@ setupkvm(void)
 	pde_t *pgdir;
 	struct kmap *k;
 
-	if((pgdir = (pde_t*)kalloc()) == 0)
+	if((pgdir = (pde_t*)kalloczeroed()) == 0)
 		return 0;
-	memset(pgdir, 0, PGSIZE);
 	if (P2V(PHYSTOP) > (void*)DEVSPACE)
 		panic("PHYSTOP too high");
 	for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
@@ -198,10 +201,126 @@ switchuvm(struct proc *p)
 	// forbids I/O instructions (e.g., inb and outb) from user space
 	mycpu()->ts.iomb = (ushort) 0xFFFF;
 	ltr(SEG_TSS << 3);
-	lcr3(V2P(p->pgdir));  // switch to process's address space
+	if(sysenterok)
+		wrmsr(MSR_SYSENTER_ESP, (uint)p->kstack + KSTACKSIZE);
+	// The scheduler leaves the last page table loaded, so running
+	// the same address space again costs no TLB refill.
+	if(mycpu()->pgdir != p->pgdir){
+		mycpu()->pgdir = p->pgdir;
+		lcr3(V2P(p->pgdir));  // switch to process's address space
+	}
 	popcli();
 }
 
+// TLB shootdown.
+//
+// A CPU keeps the last user page table in %cr3 until it runs a
+// process with a different one (see switchuvm), so a page table can
+// be live on CPUs other than the one changing it.  Whoever removes
+// or downgrades a mapping calls tlbflush(), which invalidates the
+// range here and sends T_TLBFLUSH to each other CPU that has pgdir
+// loaded, then waits for them.  One request is in flight at a time.
+// A CPU spinning in acquire() with interrupts off polls for requests
+// (tlbpoll), since the sender may hold the lock it waits for.
+
+#define TLBFULL 32   // pages above which a full %cr3 reload is cheaper
+
+static struct {
+	volatile uint busy;
+	pde_t *pgdir;
+	uint va;
+	uint end;        // 0: drop pgdir altogether
+} shoot;
+
+static void
+tlblocal(struct cpu *c, pde_t *pgdir, uint va, uint end)
+{
+	if(c->pgdir != pgdir)
+		return;
+	if(end == 0){
+		c->pgdir = 0;
+		switchkvm();
+	} else if(end - va > TLBFULL*PGSIZE)
+		lcr3(V2P(pgdir));
+	else
+		for(; va < end; va += PGSIZE)
+			invlpg((void*)va);
+}
+
+// Serve a shootdown request aimed at this CPU, if any.
+// Called with interrupts off.
+void
+tlbpoll(void)
+{
+	struct cpu *c = mycpu();
+
+	if(!c->tlbreq)
+		return;
+	tlblocal(c, shoot.pgdir, shoot.va, shoot.end);
+	__sync_synchronize();
+	c->tlbreq = 0;
+}
+
+static void
+shootdown(pde_t *pgdir, uint va, uint end)
+{
+	struct cpu *c, *me;
+	int wait;
+
+	pushcli();
+	me = mycpu();
+	// Make the page table change visible before anyone reloads.
+	// A CPU that loads pgdir after this sees it; if none has it
+	// loaded now there is nothing to do (freevm's unmaps, say).
+	__sync_synchronize();
+	for(c = cpus; c < cpus+ncpu; c++)
+		if(c->pgdir == pgdir)
+			break;
+	if(c == cpus+ncpu){
+		popcli();
+		return;
+	}
+	while(xchg(&shoot.busy, 1) != 0){
+		tlbpoll();
+		pause();
+	}
+	shoot.pgdir = pgdir;
+	shoot.va = va;
+	shoot.end = end;
+	for(c = cpus; c < cpus+ncpu; c++){
+		if(c == me || !c->started || c->pgdir != pgdir)
+			continue;
+		c->tlbreq = 1;
+		lapicipi(c->apicid, T_TLBFLUSH);
+	}
+	do{
+		tlbpoll();
+		wait = 0;
+		for(c = cpus; c < cpus+ncpu; c++)
+			wait |= c->tlbreq;
+		if(wait)
+			pause();
+	} while(wait);
+	xchg(&shoot.busy, 0);
+	tlblocal(me, pgdir, va, end);
+	popcli();
+}
+
+// Invalidate [va, end) of pgdir on every CPU that may cache it.
+void
+tlbflush(pde_t *pgdir, uint va, uint end)
+{
+	if(va < end)
+		shootdown(pgdir, PGROUNDDOWN(va), PGROUNDUP(end));
+}
+
+// Make sure no CPU has pgdir loaded, before it is freed.
+void
+tlbdrop(pde_t *pgdir)
+{
+	shootdown(pgdir, 0, 0);
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -211,8 +330,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
 
 	if(sz >= PGSIZE)
 		panic("inituvm: more than a page");
-	mem = kalloc();
-	memset(mem, 0, PGSIZE);
+	mem = kalloczeroed();
 	mappages(pgdir, 0, PGSIZE, V2P(mem), PTE_W|PTE_U);
 	memmove(mem, init, sz);
 }
@@ -228,9 +346,12 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 	if((uint) addr % PGSIZE != 0)
 		panic("loaduvm: addr must be page aligned");
 	for(i = 0; i < sz; i += PGSIZE){
-		if((pte = walkpgdir(pgdir, addr+i, 0)) == 0)
+		if(pgdir[PDX(addr+i)] & PTE_PS)
+			pa = PTE_ADDR(pgdir[PDX(addr+i)]) + ((uint)(addr+i) & (BIGPGSIZE-1));
+		else if((pte = walkpgdir(pgdir, addr+i, 0)) != 0)
+			pa = PTE_ADDR(*pte);
+		else
 			panic("loaduvm: address should exist");
-		pa = PTE_ADDR(*pte);
 		if(sz - i < PGSIZE)
 			n = sz - i;
 		else
@@ -243,26 +364,44 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 
 // Allocate page tables and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Aligned 4 MiB stretches that the growth covers entirely get one big
+// page when kalloccontig() can find the memory, cutting TLB misses and
+// page table pages for large heaps.
 int
 allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
 	char *mem;
-	uint a;
+	uint a, n;
 
-	if(newsz >= VIRT_SHM_MEM)
+	if(newsz > VIRT_KINFO)
 		return 0;
 	if(newsz < oldsz)
 		return oldsz;
 
 	a = PGROUNDUP(oldsz);
 	for(; a < newsz; a += PGSIZE){
-		mem = kalloc();
+		if(pgdir[PDX(a)] & PTE_PS){
+			// Kept by an earlier partial shrink; just clear it again.
+			n = BIGPGROUNDDOWN(a) + BIGPGSIZE;
+			if(n > newsz)
+				n = newsz;
+			memset(P2V(PTE_ADDR(pgdir[PDX(a)])) + (a - BIGPGROUNDDOWN(a)), 0, n - a);
+			a = PGROUNDUP(n) - PGSIZE;
+			continue;
+		}
+		if(a % BIGPGSIZE == 0 && newsz - a >= BIGPGSIZE && !(pgdir[PDX(a)] & PTE_P) &&
+		   (mem = kalloccontig(NPTENTRIES, BIGPGSIZE)) != 0){
+			memset(mem, 0, BIGPGSIZE);
+			pgdir[PDX(a)] = V2P(mem) | PTE_PS | PTE_P | PTE_W | PTE_U;
+			a += BIGPGSIZE - PGSIZE;
+			continue;
+		}
+		mem = kallocuser(1);
 		if(mem == 0){
 			cprintf("allocuvm out of memory\n");
 			deallocuvm(pgdir, newsz, oldsz);
 			return 0;
 		}
-		memset(mem, 0, PGSIZE);
 		if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
 			cprintf("allocuvm out of memory (2)\n");
 			deallocuvm(pgdir, newsz, oldsz);
@@ -277,17 +416,36 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
 // process size.  Returns the new process size.
+// Pages are unmapped in batches of UNMAPBATCH: one TLB flush covers
+// the batch before its frames go back to the allocator.
+#define UNMAPBATCH 32
+
 int
 deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
 	pte_t *pte;
-	uint a, pa;
+	uint a, pa, lo;
+	char *batch[UNMAPBATCH], *big;
+	int n, i;
 
 	if(newsz >= oldsz)
 		return oldsz;
 
-	a = PGROUNDUP(newsz);
+	n = 0;
+	lo = a = PGROUNDUP(newsz);
 	for(; a  < oldsz; a += PGSIZE){
+		if(pgdir[PDX(a)] & PTE_PS){
+			// A big page goes only when all of it is above newsz;
+			// otherwise it stays whole until a later shrink.
+			if(BIGPGROUNDDOWN(a) >= newsz){
+				big = P2V(PTE_ADDR(pgdir[PDX(a)]));
+				pgdir[PDX(a)] = 0;
+				tlbflush(pgdir, a, a + PGSIZE);
+				kfreecontig(big, NPTENTRIES);
+			}
+			a = BIGPGROUNDDOWN(a) + BIGPGSIZE - PGSIZE;
+			continue;
+		}
 		pte = walkpgdir(pgdir, (char*)a, 0);
 		if(!pte)
 			a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
@@ -295,11 +453,26 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 			pa = PTE_ADDR(*pte);
 			if(pa == 0)
 				panic("kfree");
-			char *v = P2V(pa);
-			kfree(v);
+			if(n == 0)
+				lo = a;
+			batch[n++] = P2V(pa);
+			*pte = 0;
+			if(n == UNMAPBATCH){
+				tlbflush(pgdir, lo, a + PGSIZE);
+				for(i = 0; i < n; i++)
+					kfree(batch[i]);
+				n = 0;
+			}
+		} else if(*pte & PTE_SWAP){
+			swapfree(*pte);
 			*pte = 0;
 		}
 	}
+	if(n > 0){
+		tlbflush(pgdir, lo, a);
+		for(i = 0; i < n; i++)
+			kfree(batch[i]);
+	}
 	return newsz;
 }
 
@@ -312,10 +485,15 @@ freevm(pde_t *pgdir)
 
 	if(pgdir == 0)
 		panic("freevm: no pgdir");
+	// No CPU may walk it from here on, so the unmaps below need
+	// no shootdowns.
+	tlbdrop(pgdir);
+	kinfounmap(pgdir);
 	// changed from KERNBASE
 	deallocuvm(pgdir, VIRT_SHM_MEM, 0);
 	for(i = 0; i < NPDENTRIES; i++){
-		if(pgdir[i] & PTE_P){
+		// Big pages left here are shm mappings, owned by the object.
+		if((pgdir[i] & PTE_P) && !(pgdir[i] & PTE_PS)){
 			char * v = P2V(PTE_ADDR(pgdir[i]));
 			kfree(v);
 		}
@@ -323,6 +501,36 @@ freevm(pde_t *pgdir)
 	kfree((char*)pgdir);
 }
 
+// Count the user pages of pgdir that are resident, the part of
+// them in the shm window, and those out in swap.
+void
+vmusage(pde_t *pgdir, uint *rss, uint *shm, uint *swapped)
+{
+	pte_t *pt;
+	uint i, j, n;
+
+	*rss = *shm = *swapped = 0;
+	for(i = 0; i < PDX(KERNBASE); i++){
+		if(!(pgdir[i] & PTE_P))
+			continue;
+		if(pgdir[i] & PTE_PS)
+			n = NPTENTRIES;
+		else {
+			pt = (pte_t*)P2V(PTE_ADDR(pgdir[i]));
+			n = 0;
+			for(j = 0; j < NPTENTRIES; j++){
+				if(pt[j] & PTE_P)
+					n++;
+				else if(pt[j] & PTE_SWAP)
+					(*swapped)++;
+			}
+		}
+		*rss += n;
+		if(PGADDR(i, 0, 0) >= PGROUNDUP(VIRT_SHM_MEM))
+			*shm += n;
+	}
+}
+
 // Clear PTE_U on a page. Used to create an inaccessible
 // page beneath the user stack.
 void
@@ -336,6 +544,33 @@ clearpteu(pde_t *pgdir, char *uva)
 	*pte &= ~PTE_U;
 }
 
+// Copy the big page at va in pgdir into d, as another big page
+// if contiguous memory is available and as small pages otherwise.
+static int
+copybig(pde_t *d, pde_t *pgdir, uint va)
+{
+	char *src, *mem;
+	uint flags, off;
+
+	src = P2V(PTE_ADDR(pgdir[PDX(va)]));
+	flags = PTE_FLAGS(pgdir[PDX(va)]);
+	if((mem = kalloccontig(NPTENTRIES, BIGPGSIZE)) != 0){
+		memmove(mem, src, BIGPGSIZE);
+		d[PDX(va)] = V2P(mem) | flags;
+		return 0;
+	}
+	for(off = 0; off < BIGPGSIZE; off += PGSIZE){
+		if((mem = kalloc()) == 0)
+			return -1;
+		memmove(mem, src + off, PGSIZE);
+		if(mappages(d, (void*)(va + off), PGSIZE, V2P(mem), flags & ~PTE_PS) < 0){
+			kfree(mem);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 // Given a parent process's page table, create a copy
 // of it for a child.
 pde_t*
@@ -349,15 +584,27 @@ copyuvm(pde_t *pgdir, uint sz)
 	if((d = setupkvm()) == 0)
 		return 0;
 	for(i = 0; i < sz; i += PGSIZE){
+		if(pgdir[PDX(i)] & PTE_PS){
+			if(copybig(d, pgdir, i) < 0)
+				goto bad;
+			i += BIGPGSIZE - PGSIZE;
+			continue;
+		}
 		if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
 			panic("copyuvm: pte should exist");
-		if(!(*pte & PTE_P))
+		if(!(*pte & (PTE_P|PTE_SWAP)))
 			panic("copyuvm: page not present");
-		pa = PTE_ADDR(*pte);
-		flags = PTE_FLAGS(*pte);
-		if((mem = kalloc()) == 0)
+		if((mem = kallocuser(0)) == 0)
 			goto bad;
-		memmove(mem, (char*)P2V(pa), PGSIZE);
+		// A swapped-out page is read from swap for the child only.
+		if(*pte & PTE_SWAP){
+			flags = (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_P;
+			swapcopy(*pte, mem);
+		} else {
+			pa = PTE_ADDR(*pte);
+			flags = PTE_FLAGS(*pte);
+			memmove(mem, (char*)P2V(pa), PGSIZE);
+		}
 		if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
 			kfree(mem);
 			goto bad;
@@ -375,15 +622,46 @@ char*
 uva2ka(pde_t *pgdir, char *uva)
 {
 	pte_t *pte;
+	pde_t pde;
 
+	pde = pgdir[PDX(uva)];
+	if((pde & (PTE_PS|PTE_P|PTE_U)) == (PTE_PS|PTE_P|PTE_U))
+		return (char*)P2V(PTE_ADDR(pde)) + PGROUNDDOWN((uint)uva & (BIGPGSIZE-1));
 	pte = walkpgdir(pgdir, uva, 0);
-	if((*pte & PTE_P) == 0)
+	if(pte == 0 || (*pte & PTE_P) == 0)
 		return 0;
 	if((*pte & PTE_U) == 0)
 		return 0;
 	return (char*)P2V(PTE_ADDR(*pte));
 }
 
+// Where to resume after a fault at eip in a user copy, or 0 if
+// eip is not in one.  See usercopy.S.
+uint
+extablefind(uint eip)
+{
+	extern uint extable[], eextable[];
+	uint *e;
+
+	for(e = extable; e < eextable; e += 2)
+		if(e[0] == eip)
+			return e[1];
+	return 0;
+}
+
+// Copy len bytes from user address va of the current process
+// to dst.  Its page table is loaded, so this is a plain copy
+// that fails, rather than faults, on a bad page.
+int
+copyin(void *dst, uint va, uint len)
+{
+	struct proc *curproc = myproc();
+
+	if(va >= curproc->sz || va + len > curproc->sz || va + len < va)
+		return -1;
+	return ucopy(dst, (void*)va, len);
+}
+
 // Copy len bytes from p to user address va in page table pgdir.
 // Most useful when pgdir is not the current page table.
 // uva2ka ensures this only works for PTE_U pages.
@@ -60,6 +60,27 @@ stosl(void *addr, int data, int cnt)
 		     "memory", "cc");
 }
 
+static inline void
+movsl(void *dst, const void *src, int cnt)
+{
+	asm volatile("cld; rep movsl" :
+		     "=D" (dst), "=S" (src), "=c" (cnt) :
+		     "0" (dst), "1" (src), "2" (cnt) :
+		     "memory", "cc");
+}
+
+// Copy cnt longs downwards; dst and src point at the last ones.
+// Interrupts may arrive with the direction flag set, which is
+// why alltraps clears it.
+static inline void
+rmovsl(void *dst, const void *src, int cnt)
+{
+	asm volatile("std; rep movsl; cld" :
+		     "=D" (dst), "=S" (src), "=c" (cnt) :
+		     "0" (dst), "1" (src), "2" (cnt) :
+		     "memory", "cc");
+}
+
 static inline void
 lgdt(segdesc *p, int size)
 {
@@ -129,6 +150,91 @@ xchg(volatile uint *addr, uint newval)
 	return result;
 }
 
+// Atomically add incr to *addr and return the old value.
+static inline uint
+fetchadd(volatile uint *addr, uint incr)
+{
+	uint result;
+
+	asm volatile("lock; xaddl %0, %1" :
+		     "=r" (result), "+m" (*addr) :
+		     "0" (incr) :
+		     "memory", "cc");
+	return result;
+}
+
+// Atomically replace *addr with newval if it still holds old.
+// Returns 1 if the swap happened.
+static inline int
+cas(volatile uint *addr, uint old, uint newval)
+{
+	uchar ok;
+
+	asm volatile("lock; cmpxchgl %3, %1; sete %0" :
+		     "=q" (ok), "+m" (*addr), "+a" (old) :
+		     "r" (newval) :
+		     "memory", "cc");
+	return ok;
+}
+
+// Spin-wait hint; keeps a busy-waiting CPU from starving its
+// hyperthread sibling and avoids a memory-order flush on exit.
+static inline void
+pause(void)
+{
+	asm volatile("pause");
+}
+
+// Read the time-stamp counter.
+static inline uint64
+rdtsc(void)
+{
+	uint lo, hi;
+
+	asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64)hi << 32) | lo;
+}
+
+// Divide n by d.  The quotient must fit in 32 bits, so d must
+// exceed the high half of n.
+static inline uint
+divl(uint64 n, uint d)
+{
+	uint q, r;
+
+	asm("divl %4" : "=a" (q), "=d" (r) : "0" ((uint)n), "1" ((uint)(n >> 32)), "rm" (d));
+	return q;
+}
+
+static inline void
+x86cpuid(uint info, uint *eaxp, uint *ebxp, uint *ecxp, uint *edxp)
+{
+	uint eax, ebx, ecx, edx;
+
+	asm volatile("cpuid" :
+		     "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) :
+		     "a" (info), "c" (0));
+	if(eaxp)
+		*eaxp = eax;
+	if(ebxp)
+		*ebxp = ebx;
+	if(ecxp)
+		*ecxp = ecx;
+	if(edxp)
+		*edxp = edx;
+}
+
+// Model-specific registers for sysenter.
+#define MSR_SYSENTER_CS   0x174
+#define MSR_SYSENTER_ESP  0x175
+#define MSR_SYSENTER_EIP  0x176
+
+static inline void
+wrmsr(uint msr, uint64 val)
+{
+	asm volatile("wrmsr" : : "c" (msr), "a" ((uint)val), "d" ((uint)(val >> 32)));
+}
+
 static inline uint
 rcr2(void)
 {
@@ -143,12 +249,28 @@ lcr3(uint val)
 	asm volatile("movl %0,%%cr3" : : "r" (val));
 }
 
+// Drop the TLB entry for the page containing va.
+static inline void
+invlpg(void *va)
+{
+	asm volatile("invlpg (%0)" : : "r" (va) : "memory");
+}
+
 static inline void
 hlt(void)
 {
 	asm volatile("hlt");
 }
 
+// Enable interrupts and halt.  sti takes effect only after the
+// next instruction, so an interrupt already pending wakes the hlt
+// rather than slipping in before it.
+static inline void
+stihlt(void)
+{
+	asm volatile("sti; hlt");
+}
+
 // Layout of the trap frame built on the stack by the
 // hardware and by trapasm.S, and passed to trap().
 struct trapframe {
@@ -18,17 +18,18 @@
 #define NINODES 200
 
 // Disk layout:
-// [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
+// [ boot block | sb block | log | inode blocks | free bit map | data blocks | swap ]
 
-int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int fssize = FSSIZE;   // -s: total file system blocks
+int ninodes = NINODES; // -i
+int nlog = LOGSIZE+1;  // -l: header block plus LOGSIZE blocks
+int nbitmap;
+int ninodeblocks;
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
 int fsfd;
 struct superblock sb;
-char zeroes[BSIZE];
 uint freeinode = 1;
 uint freeblock;
 
@@ -45,6 +46,13 @@ void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
 
+void
+usage(void)
+{
+	fprintf(stderr, "Usage: mkfs [-s blocks] [-i inodes] [-l logblocks] fs.img files...\n");
+	exit(1);
+}
+
 // convert to intel byte order
 ushort
 xshort(ushort x)
@@ -153,39 +161,81 @@ main(int argc, char *argv[])
 
 	static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
-	if(argc < 2){
-		fprintf(stderr, "Usage: mkfs fs.img files...\n");
+	while((i = getopt(argc, argv, "s:i:l:")) != -1){
+		switch(i){
+		case 's':
+			fssize = atoi(optarg);
+			break;
+		case 'i':
+			ninodes = atoi(optarg);
+			break;
+		case 'l':
+			nlog = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if(optind >= argc)
+		usage();
+	// The kernel's in-memory log header holds LOGSIZE blocks, and
+	// a transaction may need MAXOPBLOCKS of them.
+	if(nlog < MAXOPBLOCKS+1 || nlog > LOGSIZE+1){
+		fprintf(stderr, "mkfs: log size must be %d to %d blocks\n",
+			MAXOPBLOCKS+1, LOGSIZE+1);
+		exit(1);
+	}
+	if(ninodes < 2 || ninodes > 65535){  // dirent.inum is a ushort
+		fprintf(stderr, "mkfs: inode count must be 2 to 65535\n");
+		exit(1);
+	}
+	// 28-bit LBA, swap included
+	if(fssize <= 0 || (uint)fssize + SWAPBLOCKS > (1 << 28)){
+		fprintf(stderr, "mkfs: bad file system size %d\n", fssize);
 		exit(1);
 	}
 
 	assert((BSIZE % sizeof(struct dinode)) == 0);
 	assert((BSIZE % sizeof(struct dirent)) == 0);
 
-	fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
+	fsfd = open(argv[optind], O_RDWR|O_CREAT|O_TRUNC, 0666);
 	if(fsfd < 0){
-		perror(argv[1]);
+		perror(argv[optind]);
 		exit(1);
 	}
 
 	// 1 fs block = 1 disk sector
+	nbitmap = fssize/BPB + 1;
+	ninodeblocks = ninodes/IPB + 1;
 	nmeta = 2 + nlog + ninodeblocks + nbitmap;
-	nblocks = FSSIZE - nmeta;
+	if(nmeta >= fssize){
+		fprintf(stderr, "mkfs: %d blocks do not hold %d of metadata\n",
+			fssize, nmeta);
+		exit(1);
+	}
+	nblocks = fssize - nmeta;
 
-	sb.size = xint(FSSIZE);
+	sb.size = xint(fssize);
 	sb.nblocks = xint(nblocks);
-	sb.ninodes = xint(NINODES);
+	sb.ninodes = xint(ninodes);
 	sb.nlog = xint(nlog);
 	sb.logstart = xint(2);
 	sb.inodestart = xint(2+nlog);
 	sb.bmapstart = xint(2+nlog+ninodeblocks);
+	sb.swapstart = xint(fssize);
+	sb.nswap = xint(SWAPBLOCKS);
 
-	printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
-	        nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+	printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d swap %d\n",
+	        nmeta, nlog, ninodeblocks, nbitmap, nblocks, fssize, SWAPBLOCKS);
 
 	freeblock = nmeta;     // the first free block that we can allocate
 
-	for(i = 0; i < FSSIZE; i++)
-		wsect(i, zeroes);
+	// The file is empty after O_TRUNC; extending it reads as zeros
+	// without writing every sector of a large image.
+	if(ftruncate(fsfd, (off_t)(fssize + SWAPBLOCKS) * BSIZE) < 0){
+		perror("ftruncate");
+		exit(1);
+	}
 
 	memset(buf, 0, sizeof(buf));
 	memmove(buf, &sb, sizeof(sb));
@@ -193,7 +243,7 @@ main(int argc, char *argv[])
 
 	makedirs();
 
-	for(i = 2; i < argc; i++){
+	for(i = optind+1; i < argc; i++){
 		// get rid of "user/"
 		if(strncmp(argv[i], "user/", 5) == 0)
 			shortname = argv[i] + 5;
@@ -297,6 +347,11 @@ ialloc(ushort type)
 	uint inum = freeinode++;
 	struct dinode din;
 
+	if(inum >= ninodes){
+		fprintf(stderr, "mkfs: out of inodes, try a larger -i\n");
+		exit(1);
+	}
+
 	bzero(&din, sizeof(din));
 	din.type = xshort(type);
 	din.nlink = xshort(1);
@@ -305,20 +360,26 @@ ialloc(ushort type)
 	return inum;
 }
 
+// Mark blocks [0, used) allocated; the rest of the bitmap is
+// already zero.
 void
 balloc(int used)
 {
 	uchar buf[BSIZE];
-	int i;
+	int b, i;
 
 	printf("balloc: first %d blocks have been allocated\n", used);
-	assert(used < BSIZE*8);
-	bzero(buf, BSIZE);
-	for(i = 0; i < used; i++){
-		buf[i/8] = buf[i/8] | (0x1 << (i%8));
+	if(used > fssize){
+		fprintf(stderr, "mkfs: out of blocks, try a larger -s\n");
+		exit(1);
+	}
+	for(b = 0; b < used; b += BPB){
+		bzero(buf, BSIZE);
+		for(i = 0; i < BPB && b + i < used; i++)
+			buf[i/8] = buf[i/8] | (0x1 << (i%8));
+		printf("balloc: write bitmap block at sector %d\n", sb.bmapstart + b/BPB);
+		wsect(sb.bmapstart + b/BPB, buf);
 	}
-	printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-	wsect(sb.bmapstart, buf);
 }
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
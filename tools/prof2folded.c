@@ -0,0 +1,226 @@
+// Convert the output of user/prof.c, as captured from the console,
+// to folded stacks, one "proc;caller;...;callee count" line per
+// distinct stack, for flamegraph.pl and similar tools:
+//
+//	$ make qemu-nox | tee console.log
+//	$ tools/prof2folded < console.log > prof.folded
+//	$ flamegraph.pl prof.folded > prof.svg
+//
+// Kernel addresses are looked up in the kernel ELF file, user ones
+// in the binary named after the process, _name in the user
+// directory.  Kernel frames get flamegraph.pl's "_[k]" suffix.
+// Lines that are not profiler output are ignored.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#include "kernel/types.h"
+#include "kernel/memlayout.h"
+
+#define MAXDEPTH 64
+
+struct sym {
+	uint addr;
+	char *name;
+};
+
+struct symtab {
+	char *prog;      // process name; 0 for the kernel
+	struct sym *syms;
+	int n;
+	struct symtab *next;
+};
+
+static char *kernelpath = "kernel/kernel";
+static char *userdir = "user";
+static struct symtab *kernsyms, *usersyms;
+
+static int
+cmpsym(const void *a, const void *b)
+{
+	const struct sym *x = a, *y = b;
+
+	if(x->addr != y->addr)
+		return x->addr < y->addr ? -1 : 1;
+	return 0;
+}
+
+static int
+cmpstr(const void *a, const void *b)
+{
+	return strcmp(*(char**)a, *(char**)b);
+}
+
+// Read the function symbols of the ELF file at path into t.
+// A missing or unreadable file leaves t empty.
+static void
+loadsyms(char *path, struct symtab *t)
+{
+	FILE *f;
+	long size;
+	char *img, *strs;
+	Elf32_Ehdr *eh;
+	Elf32_Shdr *sh;
+	Elf32_Sym *st;
+	int i, j, nst, type;
+
+	t->syms = 0;
+	t->n = 0;
+	if((f = fopen(path, "r")) == 0)
+		return;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	if((img = malloc(size)) == 0 || fread(img, 1, size, f) != size){
+		fprintf(stderr, "prof2folded: cannot read %s\n", path);
+		exit(1);
+	}
+	fclose(f);
+	eh = (Elf32_Ehdr*)img;
+	if(size < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+	   eh->e_ident[EI_CLASS] != ELFCLASS32){
+		fprintf(stderr, "prof2folded: %s: not a 32-bit ELF file\n", path);
+		return;
+	}
+	sh = (Elf32_Shdr*)(img + eh->e_shoff);
+	for(i = 0; i < eh->e_shnum; i++){
+		if(sh[i].sh_type != SHT_SYMTAB)
+			continue;
+		st = (Elf32_Sym*)(img + sh[i].sh_offset);
+		nst = sh[i].sh_size / sizeof(*st);
+		strs = img + sh[sh[i].sh_link].sh_offset;
+		t->syms = malloc(nst * sizeof(*t->syms));
+		for(j = 0; j < nst; j++){
+			type = ELF32_ST_TYPE(st[j].st_info);
+			// Assembly routines are untyped globals.
+			if(type != STT_FUNC && !(type == STT_NOTYPE &&
+			   ELF32_ST_BIND(st[j].st_info) == STB_GLOBAL))
+				continue;
+			if(st[j].st_shndx == SHN_UNDEF || strs[st[j].st_name] == 0)
+				continue;
+			t->syms[t->n].addr = st[j].st_value;
+			t->syms[t->n].name = strs + st[j].st_name;
+			t->n++;
+		}
+		qsort(t->syms, t->n, sizeof(*t->syms), cmpsym);
+		return;
+	}
+}
+
+// Symbols for the user binary of process prog, loaded on first use.
+static struct symtab*
+usertab(char *prog)
+{
+	struct symtab *t;
+	char path[512];
+
+	for(t = usersyms; t; t = t->next)
+		if(strcmp(t->prog, prog) == 0)
+			return t;
+	t = malloc(sizeof(*t));
+	t->prog = strdup(prog);
+	snprintf(path, sizeof(path), "%s/_%s", userdir, prog);
+	loadsyms(path, t);
+	t->next = usersyms;
+	usersyms = t;
+	return t;
+}
+
+// Name the function containing pc.
+static char*
+lookup(struct symtab *t, uint pc)
+{
+	static char buf[16];
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = t->n - 1;
+	while(lo <= hi){
+		mid = (lo + hi) / 2;
+		if(t->syms[mid].addr <= pc)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	if(hi < 0){
+		snprintf(buf, sizeof(buf), "0x%x", pc);
+		return buf;
+	}
+	return t->syms[hi].name;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char line[1024], prog[32], stack[4096], *p, **stacks;
+	uint pcs[MAXDEPTH], pc;
+	int i, n, depth, off, nstack, maxstack, cpu, pid, total;
+	struct symtab *user;
+
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-k") == 0 && i+1 < argc)
+			kernelpath = argv[++i];
+		else if(strcmp(argv[i], "-u") == 0 && i+1 < argc)
+			userdir = argv[++i];
+		else {
+			fprintf(stderr, "usage: prof2folded [-k kernel] [-u userdir] "
+				"< console.log > prof.folded\n");
+			exit(1);
+		}
+	}
+	kernsyms = malloc(sizeof(*kernsyms));
+	loadsyms(kernelpath, kernsyms);
+	if(kernsyms->n == 0){
+		fprintf(stderr, "prof2folded: no symbols in %s\n", kernelpath);
+		exit(1);
+	}
+
+	stacks = 0;
+	nstack = maxstack = 0;
+	while(fgets(line, sizeof(line), stdin) != 0){
+		if(sscanf(line, "@ps %d %d %31s %d%n", &cpu, &pid, prog, &depth, &off) != 4)
+			continue;
+		if(depth < 1 || depth > MAXDEPTH)
+			continue;
+		p = line + off;
+		for(i = 0; i < depth; i++){
+			if(sscanf(p, " %x%n", &pcs[i], &n) != 1)
+				break;
+			p += n;
+		}
+		if(i < depth)
+			continue;
+
+		// Root first: the process, then callers down to the sampled pc.
+		// Return addresses point after the call, hence pc-1.
+		user = strcmp(prog, "-") == 0 ? 0 : usertab(prog);
+		n = snprintf(stack, sizeof(stack), "%s", user ? prog : "[scheduler]");
+		for(i = depth - 1; i >= 0 && n < sizeof(stack); i--){
+			pc = i > 0 ? pcs[i] - 1 : pcs[i];
+			if(pc >= KERNBASE)
+				n += snprintf(stack + n, sizeof(stack) - n, ";%s_[k]",
+					lookup(kernsyms, pc));
+			else if(user)
+				n += snprintf(stack + n, sizeof(stack) - n, ";%s",
+					lookup(user, pc));
+		}
+		if(nstack == maxstack){
+			maxstack = maxstack ? 2*maxstack : 1024;
+			if((stacks = realloc(stacks, maxstack * sizeof(*stacks))) == 0){
+				perror("prof2folded");
+				exit(1);
+			}
+		}
+		stacks[nstack++] = strdup(stack);
+	}
+
+	qsort(stacks, nstack, sizeof(*stacks), cmpstr);
+	for(i = 0; i < nstack; i += total){
+		for(total = 1; i + total < nstack && strcmp(stacks[i], stacks[i+total]) == 0; total++)
+			;
+		printf("%s %d\n", stacks[i], total);
+	}
+	exit(0);
+}
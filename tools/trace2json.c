@@ -0,0 +1,187 @@
+// Convert the output of user/trace.c, as captured from the
+// console, to the Chrome trace event format, for viewing in
+// chrome://tracing or Perfetto:
+//
+//	$ make qemu-nox | tee console.log
+//	$ tools/trace2json < console.log > trace.json
+//
+// Lines that are not trace output are ignored.  CPUs show up as
+// one process with a thread per CPU and the processes that ran on
+// it; xv6 processes as another, with their system calls, log
+// commits, buffer cache lookups and page faults; disk requests as
+// a third.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/syscallnames.h"
+#include "kernel/trace.h"
+
+struct ev {
+	unsigned long long tsc;
+	int cpu, type, pid;
+	unsigned int a0;
+	int a1;
+};
+
+static char *states[] = {
+	"unused", "embryo", "sleeping", "runnable", "running", "zombie"
+};
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+static struct ev *evs;
+static int nev, maxev;
+static double cyclesperus;
+static unsigned long long t0;
+static int ncpu;
+static int first = 1;
+
+static int
+cmpev(const void *a, const void *b)
+{
+	const struct ev *x = a, *y = b;
+
+	if(x->tsc != y->tsc)
+		return x->tsc < y->tsc ? -1 : 1;
+	return 0;
+}
+
+static char*
+sysname(int num)
+{
+	static char buf[16];
+
+	if(num > 0 && num < NELEM(syscallnames) && syscallnames[num])
+		return syscallnames[num];
+	snprintf(buf, sizeof(buf), "syscall %d", num);
+	return buf;
+}
+
+// Start one event object: name, phase, pid, tid, timestamp.
+static void
+begin(char *name, char *ph, int pid, int tid, unsigned long long tsc)
+{
+	printf("%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+		first ? "" : ",", name, ph, pid, tid, (tsc - t0) / cyclesperus);
+	first = 0;
+}
+
+static void
+meta(char *what, int pid, int tid, char *name)
+{
+	printf("%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+		"\"args\":{\"name\":\"%s\"}}", first ? "" : ",", what, pid, tid, name);
+	first = 0;
+}
+
+static void
+emit(struct ev *e)
+{
+	char name[32];
+
+	switch(e->type){
+	case TR_SYSCALL:
+		begin(sysname(e->a0), "B", 1, e->pid, e->tsc);
+		break;
+	case TR_SYSRET:
+		begin(sysname(e->a0), "E", 1, e->pid, e->tsc);
+		printf(",\"args\":{\"ret\":%d}", e->a1);
+		break;
+	case TR_SWITCHIN:
+		snprintf(name, sizeof(name), "pid %u", e->a0);
+		begin(name, "B", 0, e->cpu, e->tsc);
+		break;
+	case TR_SWITCHOUT:
+		snprintf(name, sizeof(name), "pid %u", e->a0);
+		begin(name, "E", 0, e->cpu, e->tsc);
+		if(e->a1 >= 0 && e->a1 < NELEM(states))
+			printf(",\"args\":{\"now\":\"%s\"}", states[e->a1]);
+		break;
+	case TR_DISKSTART:
+		begin("io", "b", 2, 0, e->tsc);
+		printf(",\"cat\":\"disk\",\"id\":%u,\"args\":{\"block\":%u,\"op\":\"%s\"}",
+			e->a0, e->a0, e->a1 ? "write" : "read");
+		break;
+	case TR_DISKDONE:
+		begin("io", "e", 2, 0, e->tsc);
+		printf(",\"cat\":\"disk\",\"id\":%u", e->a0);
+		break;
+	case TR_BGETHIT:
+	case TR_BGETMISS:
+		begin(e->type == TR_BGETHIT ? "bget hit" : "bget miss", "i", 1, e->pid, e->tsc);
+		printf(",\"s\":\"t\",\"args\":{\"block\":%u}", e->a0);
+		break;
+	case TR_COMMIT:
+		begin("commit", "B", 1, e->pid, e->tsc);
+		printf(",\"args\":{\"blocks\":%u}", e->a0);
+		break;
+	case TR_COMMITDONE:
+		begin("commit", "E", 1, e->pid, e->tsc);
+		break;
+	case TR_PGFLT:
+		begin("page fault", "i", 1, e->pid, e->tsc);
+		printf(",\"s\":\"t\",\"args\":{\"addr\":\"0x%x\",\"err\":%d}", e->a0, e->a1);
+		break;
+	default:
+		fprintf(stderr, "trace2json: unknown event type %d\n", e->type);
+		return;
+	}
+	printf("}");
+}
+
+int
+main(int argc, char *argv[])
+{
+	char line[256], name[16];
+	unsigned int hi, lo;
+	int hz, tscpertick, i;
+	struct ev e;
+
+	if(argc != 1){
+		fprintf(stderr, "usage: trace2json < console.log > trace.json\n");
+		exit(1);
+	}
+	hz = tscpertick = 0;
+	while(fgets(line, sizeof(line), stdin) != 0){
+		if(sscanf(line, "@trace hz %d tscpertick %d", &hz, &tscpertick) == 2)
+			continue;
+		if(sscanf(line, "@ev %d %d %d %x %d %x %x", &e.cpu, &e.type, &e.pid,
+		   &e.a0, &e.a1, &hi, &lo) != 7)
+			continue;
+		e.tsc = (unsigned long long)hi << 32 | lo;
+		if(nev == maxev){
+			maxev = maxev ? 2*maxev : 1024;
+			if((evs = realloc(evs, maxev * sizeof(*evs))) == 0){
+				perror("trace2json");
+				exit(1);
+			}
+		}
+		evs[nev++] = e;
+		if(e.cpu >= ncpu)
+			ncpu = e.cpu + 1;
+	}
+	if(hz <= 0 || tscpertick <= 0){
+		fprintf(stderr, "trace2json: no @trace line in input\n");
+		exit(1);
+	}
+	cyclesperus = (double)tscpertick * hz / 1000000;
+	qsort(evs, nev, sizeof(*evs), cmpev);
+	t0 = nev > 0 ? evs[0].tsc : 0;
+
+	printf("{\"traceEvents\":[");
+	meta("process_name", 0, 0, "CPUs");
+	meta("process_name", 1, 0, "processes");
+	meta("process_name", 2, 0, "disk");
+	for(i = 0; i < ncpu; i++){
+		snprintf(name, sizeof(name), "cpu %d", i);
+		meta("thread_name", 0, i, name);
+	}
+	for(i = 0; i < nev; i++)
+		emit(&evs[i]);
+	printf("\n]}\n");
+	exit(0);
+}
@@ -0,0 +1,424 @@
+// Kernel microbenchmarks, timed with rdtsc.
+//
+// usage: bench [name ...]
+//
+// Runs the named benchmarks, or all of them, and prints one line
+//
+//	bench name value unit
+//
+// per result, after a "@bench hz .. tscpertick .. ncpu .." line
+// for converting cycles to time, so that runs before and after a
+// kernel change can be compared with a script.  Latencies are in
+// cycles per operation, rates in operations or KB per second.
+//
+// xv6 has no lseek, so the random I/O benchmarks pick a random
+// file out of a set per operation instead of a random offset in
+// one file.  With more than one CPU the ping-pong benchmarks may
+// measure wakeups across CPUs rather than context switches.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "user.h"
+#include "kernel/x86.h"
+
+#define CHUNK    4096           // bytes per read or write
+#define FILESZ   (64*1024)      // sequential I/O file; below MAXFILE
+#define NPASS    8              // times FILESZ is written and read
+#define NRFILE   8              // random I/O files, all open at once
+#define RFILESZ  (8*1024)
+#define RBLK     512
+#define NRIO     512            // random I/O operations
+#define PIPEBYTES (1024*1024)
+
+static char *prog;
+static char buf[CHUNK];
+
+static void
+fail(char *what)
+{
+	fprintf(2, "bench: %s failed\n", what);
+	exit();
+}
+
+// n / d without 64-bit division, which ulib cannot do.  Returns
+// ~0 if the quotient does not fit in 32 bits.
+static uint
+div64(uint64 n, uint64 d)
+{
+	while(d >> 32){
+		n >>= 1;
+		d >>= 1;
+	}
+	if(d == 0 || (n >> 32) >= d)
+		return ~0;
+	return divl(n, d);
+}
+
+static void
+report(char *name, uint value, char *unit)
+{
+	printf("bench %s %d %s\n", name, value, unit);
+}
+
+// Report cycles per operation for n operations that took t cycles.
+static void
+latency(char *name, uint64 t, int n)
+{
+	report(name, div64(t, n), "cycles");
+}
+
+// Report count per second for count somethings in t cycles.
+static void
+rate(char *name, uint count, uint64 t, char *unit)
+{
+	report(name, div64((uint64)count * tscpertick() * HZ, t), unit);
+}
+
+// getpid() made with sysenter, as the usys.S stubs make system
+// calls; ulib's getpid() makes none.
+static int
+nullcall(void)
+{
+	int pid;
+
+	asm volatile("movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:" :
+		     "=a" (pid) : "0" (SYS_getpid) : "ecx", "edx", "memory");
+	return pid;
+}
+
+static void
+bnull(void)
+{
+	uint64 t;
+	int i, n = 100000;
+
+	nullcall();
+	t = rdtsc();
+	for(i = 0; i < n; i++)
+		nullcall();
+	latency("null", rdtsc() - t, n);
+}
+
+static void
+bfork(void)
+{
+	uint64 t;
+	int i, pid, n = 200;
+
+	t = rdtsc();
+	for(i = 0; i < n; i++){
+		if((pid = fork()) < 0)
+			fail("fork");
+		if(pid == 0)
+			exit();
+		wait();
+	}
+	latency("fork+exit", rdtsc() - t, n);
+}
+
+static void
+bexec(void)
+{
+	char *argv[] = { prog, "-exit", 0 };
+	uint64 t;
+	int i, pid, n = 100;
+
+	t = rdtsc();
+	for(i = 0; i < n; i++){
+		if((pid = fork()) < 0)
+			fail("fork");
+		if(pid == 0){
+			exec(prog, argv);
+			fail("exec");
+		}
+		wait();
+	}
+	latency("fork+exec", rdtsc() - t, n);
+}
+
+// Bounce a byte between two processes n times; returns the cycles
+// all the round trips took.
+static uint64
+pingpong(int n)
+{
+	uint64 t;
+	int i, ab[2], ba[2], pid;
+	char c = 0;
+
+	if(pipe(ab) < 0 || pipe(ba) < 0)
+		fail("pipe");
+	if((pid = fork()) < 0)
+		fail("fork");
+	if(pid == 0){
+		for(i = 0; i < n; i++){
+			if(read(ab[0], &c, 1) != 1 || write(ba[1], &c, 1) != 1)
+				fail("pipe read/write");
+		}
+		exit();
+	}
+	t = rdtsc();
+	for(i = 0; i < n; i++){
+		if(write(ab[1], &c, 1) != 1 || read(ba[0], &c, 1) != 1)
+			fail("pipe read/write");
+	}
+	t = rdtsc() - t;
+	wait();
+	close(ab[0]);
+	close(ab[1]);
+	close(ba[0]);
+	close(ba[1]);
+	return t;
+}
+
+static void
+bpipelat(void)
+{
+	int n = 2000;
+
+	latency("pipe-roundtrip", pingpong(n), n);
+}
+
+static void
+bpipebw(void)
+{
+	uint64 t;
+	int p[2], pid, n, total;
+
+	if(pipe(p) < 0)
+		fail("pipe");
+	if((pid = fork()) < 0)
+		fail("fork");
+	if(pid == 0){
+		close(p[0]);
+		for(total = 0; total < PIPEBYTES; total += CHUNK)
+			if(write(p[1], buf, CHUNK) != CHUNK)
+				fail("pipe write");
+		exit();
+	}
+	close(p[1]);
+	t = rdtsc();
+	for(total = 0; (n = read(p[0], buf, CHUNK)) > 0; total += n)
+		;
+	t = rdtsc() - t;
+	close(p[0]);
+	wait();
+	if(total != PIPEBYTES)
+		fail("pipe read");
+	rate("pipe-bw", total >> 10, t, "KB/s");
+}
+
+// A round trip is two switches, each with a one-byte pipe write
+// and read; take away the cost of those without the switch.
+static void
+bctxsw(void)
+{
+	uint64 t, rt;
+	int i, p[2], n = 2000;
+	char c = 0;
+
+	if(pipe(p) < 0)
+		fail("pipe");
+	t = rdtsc();
+	for(i = 0; i < n; i++){
+		if(write(p[1], &c, 1) != 1 || read(p[0], &c, 1) != 1)
+			fail("pipe read/write");
+	}
+	t = rdtsc() - t;
+	close(p[0]);
+	close(p[1]);
+	rt = pingpong(n);
+	latency("ctxsw", rt > 2*t ? (rt - 2*t) >> 1 : 0, n);
+}
+
+static void
+bcreate(void)
+{
+	uint64 t;
+	int i, fd, n = 100;
+
+	t = rdtsc();
+	for(i = 0; i < n; i++){
+		if((fd = open("benchf", O_CREATE|O_RDWR)) < 0)
+			fail("create");
+		close(fd);
+		if(unlink("benchf") < 0)
+			fail("unlink");
+	}
+	t = rdtsc() - t;
+	latency("create+unlink", t, n);
+	rate("create+unlink-rate", n, t, "ops/s");
+}
+
+static void
+bseq(void)
+{
+	uint64 t;
+	int i, fd, off;
+
+	t = rdtsc();
+	for(i = 0; i < NPASS; i++){
+		if((fd = open("benchseq", O_CREATE|O_RDWR)) < 0)
+			fail("create");
+		for(off = 0; off < FILESZ; off += CHUNK)
+			if(write(fd, buf, CHUNK) != CHUNK)
+				fail("write");
+		close(fd);
+	}
+	rate("seq-write", (NPASS*FILESZ) >> 10, rdtsc() - t, "KB/s");
+
+	t = rdtsc();
+	for(i = 0; i < NPASS; i++){
+		if((fd = open("benchseq", O_RDONLY)) < 0)
+			fail("open");
+		for(off = 0; off < FILESZ; off += CHUNK)
+			if(read(fd, buf, CHUNK) != CHUNK)
+				fail("read");
+		close(fd);
+	}
+	rate("seq-read", (NPASS*FILESZ) >> 10, rdtsc() - t, "KB/s");
+	unlink("benchseq");
+}
+
+static uint rseed = 1;
+
+static uint
+rnd(void)
+{
+	rseed = rseed * 1103515245 + 12345;
+	return rseed >> 16;
+}
+
+static char rname[] = "benchr0";
+static int rfd[NRFILE], roff[NRFILE];
+
+static void
+ropen(int i, int mode)
+{
+	rname[sizeof(rname) - 2] = '0' + i;
+	if(rfd[i] > 0)
+		close(rfd[i]);
+	if((rfd[i] = open(rname, mode)) < 0)
+		fail("open");
+	roff[i] = 0;
+}
+
+// NRIO block-sized reads or writes, each in a random file of the
+// set.  A file that has been gone through is opened again.
+static uint64
+rrandom(int w)
+{
+	uint64 t;
+	int i, k, n;
+
+	for(i = 0; i < NRFILE; i++)
+		ropen(i, O_RDWR);
+	t = rdtsc();
+	for(k = 0; k < NRIO; k++){
+		i = rnd() % NRFILE;
+		if(roff[i] == RFILESZ)
+			ropen(i, O_RDWR);
+		n = w ? write(rfd[i], buf, RBLK) : read(rfd[i], buf, RBLK);
+		if(n != RBLK)
+			fail(w ? "write" : "read");
+		roff[i] += RBLK;
+	}
+	return rdtsc() - t;
+}
+
+static void
+brandom(void)
+{
+	int i, fd, off;
+
+	for(i = 0; i < NRFILE; i++){
+		rname[sizeof(rname) - 2] = '0' + i;
+		if((fd = open(rname, O_CREATE|O_RDWR)) < 0)
+			fail("create");
+		for(off = 0; off < RFILESZ; off += RBLK)
+			if(write(fd, buf, RBLK) != RBLK)
+				fail("write");
+		close(fd);
+	}
+	rate("rand-write", (NRIO*RBLK) >> 10, rrandom(1), "KB/s");
+	rate("rand-read", (NRIO*RBLK) >> 10, rrandom(0), "KB/s");
+	for(i = 0; i < NRFILE; i++){
+		close(rfd[i]);
+		rfd[i] = 0;
+		rname[sizeof(rname) - 2] = '0' + i;
+		unlink(rname);
+	}
+}
+
+static void
+bshm(void)
+{
+	uint64 t;
+	int i, od, n = 1000;
+	char *p;
+
+	t = rdtsc();
+	for(i = 0; i < n; i++){
+		if((od = shm_open("/bench")) < 0)
+			fail("shm_open");
+		if(shm_trunc(od, CHUNK) < 0 || shm_map(od, (void**)&p, O_RDWR) < 0)
+			fail("shm_map");
+		p[0] = i;
+		shm_close(od);
+	}
+	latency("shm-open+map+close", rdtsc() - t, n);
+}
+
+static struct {
+	char *name;
+	void (*f)(void);
+} benches[] = {
+	{ "null",    bnull },
+	{ "fork",    bfork },
+	{ "exec",    bexec },
+	{ "pipelat", bpipelat },
+	{ "pipebw",  bpipebw },
+	{ "ctxsw",   bctxsw },
+	{ "create",  bcreate },
+	{ "seq",     bseq },
+	{ "random",  brandom },
+	{ "shm",     bshm },
+};
+
+#define NBENCH (sizeof(benches)/sizeof(benches[0]))
+
+int
+main(int argc, char *argv[])
+{
+	int i, j;
+
+	prog = argv[0];
+	if(argc == 2 && strcmp(argv[1], "-exit") == 0)
+		exit();  // the exec'd half of fork+exec
+	for(i = 1; i < argc; i++){
+		for(j = 0; j < NBENCH; j++)
+			if(strcmp(argv[i], benches[j].name) == 0)
+				break;
+		if(j == NBENCH){
+			fprintf(2, "usage: bench [name ...]\nbenchmarks:");
+			for(j = 0; j < NBENCH; j++)
+				fprintf(2, " %s", benches[j].name);
+			fprintf(2, "\n");
+			exit();
+		}
+	}
+
+	printf("@bench hz %d tscpertick %d ncpu %d\n", HZ, tscpertick(), cpucount());
+	for(j = 0; j < NBENCH; j++){
+		if(argc == 1)
+			benches[j].f();
+		else {
+			for(i = 1; i < argc; i++)
+				if(strcmp(argv[i], benches[j].name) == 0)
+					benches[j].f();
+		}
+	}
+	exit();
+}
@@ -1,11 +1,12 @@
 // Test that fork fails gracefully.
-// Tiny executable so that the limit can be filling the proc table.
+// The process table grows until memory runs out, so N must be
+// more processes than physical memory can hold.
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "user.h"
 
-#define N  1000
+#define N  10000
 
 // forktest is not linked against printf.o, so we have our own.
 void
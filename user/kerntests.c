@@ -0,0 +1,135 @@
+// Tests of the kernel's memory accounting, info pages and timers,
+// kept out of usertests so that its binary stays within MAXFILE.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memlayout.h"
+#include "kernel/memstat.h"
+#include "user.h"
+
+// rss of the calling process, from memstat()
+static uint
+myrss(struct memstat *ms)
+{
+	static struct procmem pm[64];
+	int i, n, pid;
+
+	pid = getpid();
+	if((n = memstat(ms, pm, 64)) > 64)
+		n = 64;
+	for(i = 0; i < n; i++)
+		if(pm[i].pid == pid)
+			return pm[i].rss;
+	printf("memstat: pid %d missing\n", pid);
+	exit();
+}
+
+static void
+memstattest(void)
+{
+	struct memstat ms0, ms1;
+	uint rss0, rss1;
+
+	printf("memstat test\n");
+	rss0 = myrss(&ms0);
+	if(ms0.total == 0 || ms0.free > ms0.total || ms0.zeroed > ms0.free){
+		printf("memstat: bad totals\n");
+		exit();
+	}
+	if(sbrk(16*4096) == (char*)-1){
+		printf("memstat: sbrk failed\n");
+		exit();
+	}
+	rss1 = myrss(&ms1);
+	if(rss1 < rss0 + 16){
+		printf("memstat: rss %d -> %d after 16 pages\n", rss0, rss1);
+		exit();
+	}
+	sbrk(-16*4096);
+	if(myrss(&ms1) != rss0){
+		printf("memstat: rss not back to %d\n", rss0);
+		exit();
+	}
+	printf("memstat ok\n");
+}
+
+// The info pages: a child reads its own pid, and the pages are
+// read-only.
+static void
+kinfotest(void)
+{
+	int pid, fds[2], cpid;
+	uint t;
+
+	printf("kinfo test\n");
+	t = uptime();
+	if(cpucount() < 1 || uptime() < t){
+		printf("kinfo: bad cpu count or clock\n");
+		exit();
+	}
+	if(pipe(fds) < 0){
+		printf("kinfo: pipe failed\n");
+		exit();
+	}
+	if((pid = fork()) == 0){
+		cpid = getpid();
+		write(fds[1], &cpid, sizeof(cpid));
+		*(volatile uint*)VIRT_KINFO = 0;
+		printf("kinfo: write to info page succeeded\n");
+		exit();
+	}
+	close(fds[1]);
+	if(read(fds[0], &cpid, sizeof(cpid)) != sizeof(cpid) || cpid != pid){
+		printf("kinfo: child read pid %d, not %d\n", cpid, pid);
+		exit();
+	}
+	close(fds[0]);
+	wait();
+	printf("kinfo ok\n");
+}
+
+// nanosleep() sleeps at least as long as asked, well under a tick.
+// Ten back-to-back 200 us sleeps must take under one tick in all;
+// sleeps that waited for the next tick would take about ten.
+static void
+nanosleeptest(void)
+{
+	uint64 t;
+	uint us;
+	int i;
+
+	printf("nanosleep test\n");
+	if(nanosleep(0, 1000000000) != -1){
+		printf("nanosleep: accepted nsec >= 10^9\n");
+		exit();
+	}
+	t = tscclock();
+	for(i = 0; i < 10; i++){
+		if(nanosleep(0, 200000) < 0){
+			printf("nanosleep failed\n");
+			exit();
+		}
+	}
+	t = tscclock() - t;
+	if(t >= tscpertick()){
+		printf("nanosleep: 10 x 200 us took more than a tick\n");
+		exit();
+	}
+	us = (uint)t / (tscpertick() / 10000);
+	if(us < 2000){
+		printf("nanosleep: 10 x 200 us took %d us\n", us);
+		exit();
+	}
+	printf("nanosleep ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	printf("kerntests starting\n");
+	memstattest();
+	kinfotest();
+	nanosleeptest();
+	printf("kerntests ok\n");
+	exit();
+}
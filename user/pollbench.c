@@ -0,0 +1,95 @@
+// Multiplex N pipes from one process with poll().
+// Each of N children writes NMSG messages into its own pipe;
+// the parent drains all of them through a single poll() loop.
+//
+// usage: pollbench [npipes [nmsg [msgsize]]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/poll.h"
+#include "user.h"
+
+#define MAXPIPES 12
+
+char buf[4096];
+
+int
+main(int argc, char *argv[])
+{
+	struct pollfd fds[MAXPIPES];
+	int npipes, nmsg, msgsize, nopen, i, j, n, p[2];
+	int nready, npolls;
+	uint total, start, elapsed;
+
+	npipes = argc > 1 ? atoi(argv[1]) : 8;
+	nmsg = argc > 2 ? atoi(argv[2]) : 1000;
+	msgsize = argc > 3 ? atoi(argv[3]) : 64;
+	if(npipes < 1 || npipes > MAXPIPES || msgsize < 1 || msgsize > sizeof(buf)){
+		printf("pollbench: 1 <= npipes <= %d, 1 <= msgsize <= %d\n",
+		       MAXPIPES, sizeof(buf));
+		exit();
+	}
+
+	start = uptime();
+	for(i = 0; i < npipes; i++){
+		if(pipe(p) < 0){
+			printf("pollbench: pipe failed\n");
+			exit();
+		}
+		if(fork() == 0){
+			for(j = 0; j < i; j++)
+				close(fds[j].fd);
+			close(p[0]);
+			memset(buf, 'a' + i, msgsize);
+			for(j = 0; j < nmsg; j++){
+				if(write(p[1], buf, msgsize) != msgsize){
+					printf("pollbench: write failed\n");
+					exit();
+				}
+			}
+			exit();
+		}
+		close(p[1]);
+		fcntl(p[0], F_SETFL, O_NONBLOCK);
+		fds[i].fd = p[0];
+		fds[i].events = POLLIN;
+	}
+
+	total = 0;
+	npolls = 0;
+	nopen = npipes;
+	while(nopen > 0){
+		if((nready = poll(fds, npipes, -1)) < 0){
+			printf("pollbench: poll failed\n");
+			exit();
+		}
+		npolls++;
+		for(i = 0; i < npipes; i++){
+			if(fds[i].revents & POLLIN){
+				// Non-blocking: drain whatever is buffered.
+				while((n = read(fds[i].fd, buf, sizeof(buf))) > 0)
+					total += n;
+				if(n == 0){
+					close(fds[i].fd);
+					fds[i].fd = -1;
+					nopen--;
+				}
+			} else if(fds[i].revents & POLLHUP){
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				nopen--;
+			}
+		}
+	}
+	elapsed = uptime() - start;
+	for(i = 0; i < npipes; i++)
+		wait();
+
+	if(total != npipes * nmsg * msgsize)
+		printf("pollbench: got %d bytes, expected %d\n",
+		       total, npipes * nmsg * msgsize);
+	printf("pollbench pipes %d msgs %d msgsize %d bytes %d polls %d ticks %d\n",
+	       npipes, nmsg, msgsize, total, npolls, elapsed);
+	exit();
+}
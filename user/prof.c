@@ -0,0 +1,58 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/prof.h"
+#include "user.h"
+
+// Run a command with the sampling profiler on, then print the
+// samples.  Capture the console and feed it to tools/prof2folded
+// for a flame graph:
+//
+//	$ prof usertests
+//
+// Each sample is one line, "@ps cpu pid name depth pc...", with the
+// interrupted pc first; name is "-" for the scheduler.  Samples come
+// at every timer interrupt, HZ a second on each busy CPU, and each
+// CPU keeps at most NPROF of them.
+
+#define NSAMP 32
+
+static struct profsample buf[NSAMP];
+
+int
+main(int argc, char *argv[])
+{
+	struct profsample *s;
+	int i, n, total;
+
+	if(argc < 2){
+		fprintf(2, "usage: prof cmd [args...]\n");
+		exit();
+	}
+	if(prof(PROF_START, 0, 0) < 0){
+		fprintf(2, "prof: cannot start profiling\n");
+		exit();
+	}
+	if(fork() == 0){
+		exec(argv[1], argv + 1);
+		fprintf(2, "prof: exec %s failed\n", argv[1]);
+		exit();
+	}
+	wait();
+	prof(PROF_STOP, 0, 0);
+
+	printf("@prof hz %d\n", HZ);
+	total = 0;
+	while((n = prof(PROF_READ, buf, NSAMP)) > 0){
+		for(s = buf; s < buf + n; s++){
+			printf("@ps %d %d %s %d", s->cpu, s->pid,
+				s->name[0] ? s->name : "-", s->depth);
+			for(i = 0; i < s->depth; i++)
+				printf(" %x", s->pcs[i]);
+			printf("\n");
+		}
+		total += n;
+	}
+	printf("@end %d samples\n", total);
+	exit();
+}
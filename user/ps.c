@@ -0,0 +1,56 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user.h"
+
+// Memory use of the system and of each process.
+// ps -m prints only the system-wide part.
+
+#define KB(pages) ((pages) * 4)
+
+static char *states[] = {
+	"unused", "embryo", "sleep", "runble", "run", "zombie"
+};
+
+int
+main(int argc, char **argv)
+{
+	struct memstat ms;
+	struct procmem *pm;
+	int i, n, max;
+	char *state;
+
+	if((n = memstat(&ms, 0, 0)) < 0){
+		fprintf(2, "ps: memstat failed\n");
+		exit();
+	}
+	printf("mem: total %dK used %dK free %dK (zeroed %dK)\n",
+		KB(ms.total), KB(ms.total - ms.free), KB(ms.free), KB(ms.zeroed));
+	printf("     slab %dK shm %dK bcache %dK\n",
+		KB(ms.slab), KB(ms.shm), KB(ms.bcache));
+	printf("swap: total %dK used %dK free %dK\n",
+		KB(ms.swaptotal), KB(ms.swaptotal - ms.swapfree), KB(ms.swapfree));
+	if(argc > 1 && strcmp(argv[1], "-m") == 0)
+		exit();
+
+	// Leave room for processes started in between.
+	max = n + 8;
+	if((pm = malloc(max * sizeof(*pm))) == 0){
+		fprintf(2, "ps: out of memory\n");
+		exit();
+	}
+	if((n = memstat(&ms, pm, max)) > max)
+		n = max;
+	printf("pid\tstate\tname\tsize\trss\tshm\tswap\tminflt\tmajflt\n");
+	for(i = 0; i < n; i++){
+		if(pm[i].state >= 0 && pm[i].state < sizeof(states)/sizeof(states[0]))
+			state = states[pm[i].state];
+		else
+			state = "???";
+		printf("%d\t%s\t%s\t%dK\t%dK\t%dK\t%dK\t%d\t%d\n",
+			pm[i].pid, state, pm[i].name, pm[i].sz / 1024,
+			KB(pm[i].rss), KB(pm[i].shm), KB(pm[i].swap),
+			pm[i].minflt, pm[i].majflt);
+	}
+	exit();
+}
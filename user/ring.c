@@ -0,0 +1,223 @@
+// Shared-memory message rings.  See ring.h.
+
+#include "kernel/types.h"
+#include "kernel/futex.h"
+#include "user.h"
+#include "ring.h"
+
+#define RING_MAGIC 0x52494e47  // "RING"
+
+// Each slot is a sequence word followed by the message.
+struct slot {
+	volatile uint seq;
+	char data[];
+};
+
+// Keep the compiler from moving loads and stores across this point.
+// x86 does not reorder stores with other stores or loads with other
+// loads, so that is all the slot handoff needs.
+#define barrier() asm volatile("" ::: "memory")
+
+static inline void
+cpu_relax(void)
+{
+	asm volatile("pause");
+}
+
+static inline struct slot*
+slotat(struct ring *r, uint pos)
+{
+	return (struct slot*)((char*)(r + 1) + (pos & (r->nslots - 1)) * r->stride);
+}
+
+uint
+ring_bytes(uint nslots, uint eltsize)
+{
+	uint stride;
+
+	stride = (sizeof(struct slot) + eltsize + 3) & ~3;
+	return sizeof(struct ring) + nslots * stride;
+}
+
+// Lay out a ring in mem, which must hold ring_bytes(nslots, eltsize)
+// bytes.  Returns 0 if nslots is not a power of two.
+struct ring*
+ring_init(void *mem, uint nslots, uint eltsize, int mode)
+{
+	struct ring *r;
+	uint i;
+
+	if(nslots == 0 || (nslots & (nslots - 1)) != 0 || eltsize == 0)
+		return 0;
+	if(mode != RING_SPSC && mode != RING_MPMC)
+		return 0;
+
+	r = mem;
+	memset(r, 0, sizeof(*r));
+	r->nslots = nslots;
+	r->eltsize = eltsize;
+	r->stride = (sizeof(struct slot) + eltsize + 3) & ~3;
+	r->mode = mode;
+	for(i = 0; i < nslots; i++)
+		slotat(r, i)->seq = i;
+	barrier();
+	r->magic = RING_MAGIC;
+	return r;
+}
+
+// Use a ring that another process set up in shared memory.
+struct ring*
+ring_attach(void *mem)
+{
+	struct ring *r;
+
+	r = mem;
+	if(r->magic != RING_MAGIC)
+		return 0;
+	return r;
+}
+
+static int
+put1(struct ring *r, const void *msg)
+{
+	struct slot *s;
+	uint pos;
+	int dif;
+
+	pos = r->head;
+	for(;;){
+		s = slotat(r, pos);
+		dif = (int)(s->seq - pos);
+		if(dif < 0)
+			return -1;  // full
+		if(dif > 0){
+			// Another producer took this slot; catch up.
+			pos = r->head;
+			continue;
+		}
+		if(r->mode == RING_SPSC){
+			r->head = pos + 1;
+			break;
+		}
+		if(__sync_bool_compare_and_swap(&r->head, pos, pos + 1))
+			break;
+		pos = r->head;
+	}
+	memmove(s->data, msg, r->eltsize);
+	barrier();
+	s->seq = pos + 1;
+	return 0;
+}
+
+static int
+get1(struct ring *r, void *msg)
+{
+	struct slot *s;
+	uint pos;
+	int dif;
+
+	pos = r->tail;
+	for(;;){
+		s = slotat(r, pos);
+		dif = (int)(s->seq - (pos + 1));
+		if(dif < 0)
+			return -1;  // empty
+		if(dif > 0){
+			pos = r->tail;
+			continue;
+		}
+		if(r->mode == RING_SPSC){
+			r->tail = pos + 1;
+			break;
+		}
+		if(__sync_bool_compare_and_swap(&r->tail, pos, pos + 1))
+			break;
+		pos = r->tail;
+	}
+	memmove(msg, s->data, r->eltsize);
+	barrier();
+	s->seq = pos + r->nslots;
+	return 0;
+}
+
+// Wake everybody asleep on seq if anyone announced themselves in
+// nwait.  The full barrier orders our slot update before the read
+// of nwait; the sleeper orders its nwait increment before its
+// retry, so one of the two always sees the other.
+static void
+wake(volatile uint *seq, volatile uint *nwait)
+{
+	__sync_synchronize();
+	if(*nwait == 0)
+		return;
+	__sync_fetch_and_add(seq, 1);
+	futex((uint*)seq, FUTEX_WAKE, 0);
+}
+
+int
+ring_tryput(struct ring *r, const void *msg)
+{
+	if(put1(r, msg) < 0)
+		return -1;
+	wake(&r->dataseq, &r->datawait);
+	return 0;
+}
+
+int
+ring_tryget(struct ring *r, void *msg)
+{
+	if(get1(r, msg) < 0)
+		return -1;
+	wake(&r->spaceseq, &r->spacewait);
+	return 0;
+}
+
+void
+ring_put(struct ring *r, const void *msg)
+{
+	uint seq;
+	int i;
+
+	for(;;){
+		for(i = 0; i < RING_SPIN; i++){
+			if(put1(r, msg) == 0)
+				goto done;
+			cpu_relax();
+		}
+		seq = r->spaceseq;
+		__sync_fetch_and_add(&r->spacewait, 1);
+		if(put1(r, msg) == 0){
+			__sync_fetch_and_sub(&r->spacewait, 1);
+			goto done;
+		}
+		futex((uint*)&r->spaceseq, FUTEX_WAIT, seq);
+		__sync_fetch_and_sub(&r->spacewait, 1);
+	}
+done:
+	wake(&r->dataseq, &r->datawait);
+}
+
+void
+ring_get(struct ring *r, void *msg)
+{
+	uint seq;
+	int i;
+
+	for(;;){
+		for(i = 0; i < RING_SPIN; i++){
+			if(get1(r, msg) == 0)
+				goto done;
+			cpu_relax();
+		}
+		seq = r->dataseq;
+		__sync_fetch_and_add(&r->datawait, 1);
+		if(get1(r, msg) == 0){
+			__sync_fetch_and_sub(&r->datawait, 1);
+			goto done;
+		}
+		futex((uint*)&r->dataseq, FUTEX_WAIT, seq);
+		__sync_fetch_and_sub(&r->datawait, 1);
+	}
+done:
+	wake(&r->spaceseq, &r->spacewait);
+}
@@ -0,0 +1,53 @@
+#ifndef RING_H
+#define RING_H
+
+// Fixed-size message rings that live in shared memory.
+//
+// A ring is a power-of-two array of slots, each tagged with a
+// sequence number that says whether it is ready for the next
+// producer or the next consumer (Vyukov's bounded queue).  In
+// RING_SPSC mode the head and tail are advanced with plain stores;
+// in RING_MPMC mode with compare-and-swap, so any number of
+// processes may put and get at once.
+//
+// ring_tryput/ring_tryget never block.  ring_put/ring_get spin for
+// a while and then sleep in the kernel with futex() until the other
+// side makes progress.  Wakeups are only issued when somebody is
+// actually asleep, so the uncontended path makes no system calls.
+
+#define RING_SPSC 0
+#define RING_MPMC 1
+
+#define RING_LINE 64   // keep hot counters on separate cache lines
+#define RING_SPIN 200  // spins before going to sleep
+
+struct ring {
+	uint magic;
+	uint nslots;         // power of two
+	uint eltsize;        // bytes per message
+	uint stride;         // bytes per slot, header included
+	uint mode;           // RING_SPSC or RING_MPMC
+	char pad0[RING_LINE - 5*sizeof(uint)];
+
+	volatile uint head;  // next slot to put into
+	char pad1[RING_LINE - sizeof(uint)];
+	volatile uint tail;  // next slot to get from
+	char pad2[RING_LINE - sizeof(uint)];
+
+	volatile uint dataseq;    // futex word consumers sleep on
+	volatile uint datawait;   // consumers asleep or about to be
+	char pad3[RING_LINE - 2*sizeof(uint)];
+	volatile uint spaceseq;   // futex word producers sleep on
+	volatile uint spacewait;  // producers asleep or about to be
+	char pad4[RING_LINE - 2*sizeof(uint)];
+};
+
+uint ring_bytes(uint nslots, uint eltsize);
+struct ring* ring_init(void *mem, uint nslots, uint eltsize, int mode);
+struct ring* ring_attach(void *mem);
+int ring_tryput(struct ring *r, const void *msg);
+int ring_tryget(struct ring *r, void *msg);
+void ring_put(struct ring *r, const void *msg);
+void ring_get(struct ring *r, void *msg);
+
+#endif
@@ -0,0 +1,233 @@
+// Message-passing throughput and latency: shared-memory rings
+// against pipes.
+//
+//   pipe   one writer, one reader, MSGSZ-byte messages over a pipe
+//   spsc   the same over a RING_SPSC ring in a shm object
+//   mpmc   two producers and two consumers sharing a RING_MPMC ring
+//   pingpong  round trips between two processes, pipe vs ring
+//
+// usage: ringbench [nmsg]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user.h"
+#include "ring.h"
+
+#define MSGSZ  64
+#define NSLOTS 256
+
+struct msg {
+	uint seq;
+	char pad[MSGSZ - sizeof(uint)];
+};
+
+// Map a fresh shm object big enough for one ring of NSLOTS messages.
+static struct ring*
+mkring(char *name, int mode, int *od)
+{
+	void *va;
+
+	if((*od = shm_open(name)) < 0 ||
+	   shm_trunc(*od, ring_bytes(NSLOTS, MSGSZ)) < 0 ||
+	   shm_map(*od, &va, O_RDWR) < 0){
+		printf("ringbench: cannot map %s\n", name);
+		exit();
+	}
+	return ring_init(va, NSLOTS, MSGSZ, mode);
+}
+
+static void
+report(char *what, int nmsg, uint ticks)
+{
+	if(ticks == 0)
+		ticks = 1;
+	printf("%s: %d msgs in %d ticks, %d msgs/tick\n",
+	       what, nmsg, ticks, nmsg / ticks);
+}
+
+static void
+pipebench(int nmsg)
+{
+	struct msg m;
+	int fds[2], i;
+	uint start;
+
+	if(pipe(fds) < 0){
+		printf("ringbench: pipe failed\n");
+		exit();
+	}
+	memset(&m, 0, sizeof(m));
+	start = uptime();
+	if(fork() == 0){
+		close(fds[0]);
+		for(i = 0; i < nmsg; i++){
+			m.seq = i;
+			write(fds[1], &m, sizeof(m));
+		}
+		exit();
+	}
+	close(fds[1]);
+	for(i = 0; i < nmsg; i++){
+		if(read(fds[0], &m, sizeof(m)) != sizeof(m) || m.seq != i){
+			printf("ringbench: pipe lost message %d\n", i);
+			break;
+		}
+	}
+	close(fds[0]);
+	wait();
+	report("pipe", nmsg, uptime() - start);
+}
+
+static void
+spscbench(int nmsg)
+{
+	struct ring *r;
+	struct msg m;
+	int od, i;
+	uint start;
+
+	r = mkring("/ringbench.spsc", RING_SPSC, &od);
+	memset(&m, 0, sizeof(m));
+	start = uptime();
+	if(fork() == 0){
+		for(i = 0; i < nmsg; i++){
+			m.seq = i;
+			ring_put(r, &m);
+		}
+		exit();
+	}
+	for(i = 0; i < nmsg; i++){
+		ring_get(r, &m);
+		if(m.seq != i){
+			printf("ringbench: spsc got %d, want %d\n", m.seq, i);
+			break;
+		}
+	}
+	wait();
+	report("spsc", nmsg, uptime() - start);
+	shm_close(od);
+}
+
+// Two producers each send nmsg/2 messages; two consumers each take
+// nmsg/2 and report the sum of sequence numbers seen through a pipe,
+// so nothing lost or duplicated goes unnoticed.
+static void
+mpmcbench(int nmsg)
+{
+	struct ring *r;
+	struct msg m;
+	int od, fds[2], i, j, half;
+	uint start, sum, part, want;
+
+	half = nmsg / 2;
+	r = mkring("/ringbench.mpmc", RING_MPMC, &od);
+	if(pipe(fds) < 0){
+		printf("ringbench: pipe failed\n");
+		exit();
+	}
+	memset(&m, 0, sizeof(m));
+	start = uptime();
+	for(j = 0; j < 2; j++){
+		if(fork() == 0){
+			for(i = 0; i < half; i++){
+				m.seq = i;
+				ring_put(r, &m);
+			}
+			exit();
+		}
+		if(fork() == 0){
+			sum = 0;
+			for(i = 0; i < half; i++){
+				ring_get(r, &m);
+				sum += m.seq;
+			}
+			write(fds[1], &sum, sizeof(sum));
+			exit();
+		}
+	}
+	close(fds[1]);
+	sum = 0;
+	for(j = 0; j < 2; j++){
+		if(read(fds[0], &part, sizeof(part)) == sizeof(part))
+			sum += part;
+	}
+	close(fds[0]);
+	for(j = 0; j < 4; j++)
+		wait();
+	report("mpmc 2x2", 2*half, uptime() - start);
+	want = 2 * ((uint)half * (half - 1) / 2);
+	if(sum != want)
+		printf("ringbench: mpmc checksum %d, want %d\n", sum, want);
+	shm_close(od);
+}
+
+static void
+pingpong(int n)
+{
+	struct ring *req, *rep;
+	struct msg m;
+	int p1[2], p2[2], od1, od2, i;
+	uint start;
+
+	memset(&m, 0, sizeof(m));
+	if(pipe(p1) < 0 || pipe(p2) < 0){
+		printf("ringbench: pipe failed\n");
+		exit();
+	}
+	start = uptime();
+	if(fork() == 0){
+		for(i = 0; i < n; i++){
+			read(p1[0], &m, sizeof(m));
+			write(p2[1], &m, sizeof(m));
+		}
+		exit();
+	}
+	for(i = 0; i < n; i++){
+		write(p1[1], &m, sizeof(m));
+		read(p2[0], &m, sizeof(m));
+	}
+	wait();
+	report("pipe pingpong", n, uptime() - start);
+	close(p1[0]);
+	close(p1[1]);
+	close(p2[0]);
+	close(p2[1]);
+
+	req = mkring("/ringbench.req", RING_SPSC, &od1);
+	rep = mkring("/ringbench.rep", RING_SPSC, &od2);
+	start = uptime();
+	if(fork() == 0){
+		for(i = 0; i < n; i++){
+			ring_get(req, &m);
+			ring_put(rep, &m);
+		}
+		exit();
+	}
+	for(i = 0; i < n; i++){
+		ring_put(req, &m);
+		ring_get(rep, &m);
+	}
+	wait();
+	report("ring pingpong", n, uptime() - start);
+	shm_close(od1);
+	shm_close(od2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int nmsg;
+
+	nmsg = argc > 1 ? atoi(argv[1]) : 100000;
+	if(nmsg < 2){
+		printf("usage: ringbench [nmsg]\n");
+		exit();
+	}
+
+	pipebench(nmsg);
+	spscbench(nmsg);
+	mpmcbench(nmsg);
+	pingpong(nmsg / 10);
+	exit();
+}
@@ -0,0 +1,55 @@
+// shm_open/shm_close churn from several processes at once.
+// Each of N children repeatedly opens and closes a name shared by
+// all of them and a long name private to itself, so lookups hit
+// both existing and freshly created objects.
+//
+// usage: shmbench [nproc [iters]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user.h"
+
+#define MAXPROC 8
+
+int
+main(int argc, char *argv[])
+{
+	char name[48];
+	int nproc, iters, i, j, od;
+	uint start, elapsed;
+
+	nproc = argc > 1 ? atoi(argv[1]) : 4;
+	iters = argc > 2 ? atoi(argv[2]) : 2000;
+	if(nproc < 1 || nproc > MAXPROC || iters < 1){
+		printf("shmbench: 1 <= nproc <= %d\n", MAXPROC);
+		exit();
+	}
+
+	start = uptime();
+	for(i = 0; i < nproc; i++){
+		if(fork() == 0){
+			strcpy(name, "/shmbench-a-rather-long-private-object-name-0");
+			name[strlen(name) - 1] = '0' + i;
+			for(j = 0; j < iters; j++){
+				if((od = shm_open("/shmbench")) < 0){
+					printf("shmbench: open failed\n");
+					exit();
+				}
+				shm_close(od);
+				if((od = shm_open(name)) < 0){
+					printf("shmbench: open %s failed\n", name);
+					exit();
+				}
+				shm_close(od);
+			}
+			exit();
+		}
+	}
+	for(i = 0; i < nproc; i++)
+		wait();
+	elapsed = uptime() - start;
+
+	printf("shmbench: %d procs x %d open/close pairs in %d ticks\n",
+	       nproc, 2*iters, elapsed);
+	exit();
+}
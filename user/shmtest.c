@@ -244,6 +244,36 @@ int test6(void)
 	return 1;
 }
 
+int test7(void)
+{
+	printf("\nstarting test 7\n");
+	printf("growing and shrinking a large object\n");
+	int ok = 1;
+	int fd = shm_open("/test7");
+	char *p;
+	// far beyond the old 128 KiB cap, pages only appear when touched
+	if (shm_trunc(fd, 8*1024*1024) < 0 || shm_map(fd, (void **) &p, O_RDWR) < 0) {
+		printf("Test 7 not OK (trunc/map)\n");
+		shm_close(fd);
+		return 1;
+	}
+	p[0] = 1;
+	p[8*1024*1024 - 1] = 2;
+	if (shm_trunc(fd, 12*1024*1024) < 0)
+		ok = 0;
+	p[12*1024*1024 - 1] = 3;
+	if (p[0] != 1 || p[8*1024*1024 - 1] != 2)
+		ok = 0;
+	// shrinking drops the tail, growing back reads zeros
+	if (shm_trunc(fd, 100) < 0 || shm_trunc(fd, 8*1024*1024) < 0)
+		ok = 0;
+	if (p[0] != 1 || p[100] != 0 || p[8*1024*1024 - 1] != 0)
+		ok = 0;
+	shm_close(fd);
+	printf("Test 7 %sOK\n", ok ? "" : "not ");
+	return !ok;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -255,6 +285,7 @@ main(int argc, char *argv[])
 	//if(test4()) goto ex;
 	//if(test5()) goto ex;
 	if(test6()) goto ex;
+	if(test7()) goto ex;
 
 ex:
 	exit();
@@ -0,0 +1,93 @@
+// Throughput of the ulib string routines, in bytes per cycle, over
+// a range of sizes and alignments.  Build the kernel with
+// make STRBENCH=1 for the same table of the kernel's versions at
+// boot.
+//
+// usage: strbench
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user.h"
+#include "kernel/x86.h"
+
+#define BUDGET  (256*1024)   // bytes per measurement
+#define MAXSIZE 65536
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+enum { MOVE, MOVEBACK, CMP, LEN, NOP };
+
+static char *names[] = {
+[MOVE]     "memmove",
+[MOVEBACK] "memmove down",
+[CMP]      "memcmp",
+[LEN]      "strlen",
+};
+static int sizes[] = { 16, 64, 256, 1024, 4096, 16384, MAXSIZE };
+static int aligns[][2] = { {0, 0}, {1, 1}, {0, 1}, {3, 2} };  // dst, src
+
+static char a[MAXSIZE + 64], b[MAXSIZE + 64];
+
+// Run op once on size bytes.
+static void
+run(int op, int size, int doff, int soff)
+{
+	switch(op){
+	case MOVE:
+		memmove(a + doff, b + soff, size);
+		break;
+	case MOVEBACK:
+		memmove(a + 8 + doff, a + soff, size);
+		break;
+	case CMP:
+		memcmp(a + doff, b + soff, size);
+		break;
+	case LEN:
+		strlen(a + doff);
+		break;
+	}
+}
+
+// Bytes per 100 cycles.
+static uint
+measure(int op, int size, int doff, int soff)
+{
+	uint i, n, cycles;
+	uint64 t;
+
+	memset(a, 'x', sizeof(a));
+	memset(b, 'x', sizeof(b));
+	if(op == LEN)
+		a[doff + size] = 0;
+	n = BUDGET / size;
+	run(op, size, doff, soff);  // warm up
+	t = rdtsc();
+	for(i = 0; i < n; i++)
+		run(op, size, doff, soff);
+	cycles = rdtsc() - t;
+	if(cycles == 0)
+		cycles = 1;
+	return n * size * 100 / cycles;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int op, i, j;
+	uint v;
+
+	printf("bytes/cycle\t");
+	for(j = 0; j < NELEM(aligns); j++)
+		printf("\t%d/%d", aligns[j][0], aligns[j][1]);
+	printf("\n");
+	for(op = 0; op < NOP; op++){
+		for(i = 0; i < NELEM(sizes); i++){
+			printf("%s\t%d", names[op], sizes[i]);
+			for(j = 0; j < NELEM(aligns); j++){
+				v = measure(op, sizes[i], aligns[j][0], aligns[j][1]);
+				printf("\t%d.%d%d", v/100, v/10%10, v%10);
+			}
+			printf("\n");
+		}
+	}
+	exit();
+}
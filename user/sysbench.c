@@ -0,0 +1,67 @@
+// Null system call latency: getpid() made with sysenter, as the
+// usys.S stubs do, against the same call made with int $T_SYSCALL
+// and against ulib's getpid(), which reads the pinfo page and
+// makes no call at all.  Reports rdtsc cycles per call.
+//
+// usage: sysbench [ncalls]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "kernel/traps.h"
+#include "user.h"
+#include "kernel/x86.h"
+
+static int
+getpidint(void)
+{
+	int pid;
+
+	asm volatile("int %1" : "=a" (pid) : "i" (T_SYSCALL), "0" (SYS_getpid) : "memory");
+	return pid;
+}
+
+static int
+getpidsysenter(void)
+{
+	int pid;
+
+	asm volatile("movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:" :
+		     "=a" (pid) : "0" (SYS_getpid) : "ecx", "edx", "memory");
+	return pid;
+}
+
+// Average cycles per call of f over n calls.
+static uint
+cycles(int (*f)(void), int n)
+{
+	uint64 t;
+	int i;
+
+	f();  // warm up
+	t = rdtsc();
+	for(i = 0; i < n; i++)
+		f();
+	t = rdtsc() - t;
+	return (uint)t / n;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int n;
+
+	n = argc > 1 ? atoi(argv[1]) : 100000;
+	if(n < 1){
+		printf("usage: sysbench [ncalls]\n");
+		exit();
+	}
+	if(getpidint() != getpidsysenter() || getpidint() != getpid()){
+		printf("sysbench: getpid results disagree\n");
+		exit();
+	}
+	printf("getpid via int:       %d cycles\n", cycles(getpidint, n));
+	printf("getpid via sysenter:  %d cycles\n", cycles(getpidsysenter, n));
+	printf("getpid via info page: %d cycles\n", cycles(getpid, n));
+	exit();
+}
@@ -0,0 +1,94 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "kernel/syscallnames.h"
+#include "kernel/sysstat.h"
+#include "user.h"
+
+// System call counts, errors and latency, busiest first.
+//
+//	sysstat              print the statistics since boot or reset
+//	sysstat -r           reset them
+//	sysstat cmd [args]   reset, run cmd, then print
+//
+// Latency is in rdtsc cycles; the histogram line gives, for each
+// power of two 2^i that had calls, how many took [2^i, 2^(i+1)).
+
+#define NSTAT 64
+
+static struct sysstat st[NSTAT];
+
+// n / d without 64-bit division, which ulib cannot do: drop low
+// bits of n until it fits, divide, and scale back.
+static uint
+avg(uint64 n, uint d)
+{
+	int shift;
+
+	for(shift = 0; n >> 32; shift++)
+		n >>= 1;
+	return ((uint)n / d) << shift;
+}
+
+static void
+print(void)
+{
+	int n, i, j, b, order[NSTAT];
+	uint kc, total;
+	struct sysstat *s;
+
+	if((n = sysstat(SYSSTAT_READ, st, NSTAT)) < 0){
+		fprintf(2, "sysstat: cannot read statistics\n");
+		exit();
+	}
+	// Busiest first; kilocycles keep the sums in 32 bits.
+	total = 0;
+	for(i = 0; i < n; i++){
+		order[i] = i;
+		total += st[i].cycles >> 10;
+		for(j = i; j > 0 && st[order[j]].cycles > st[order[j-1]].cycles; j--){
+			b = order[j];
+			order[j] = order[j-1];
+			order[j-1] = b;
+		}
+	}
+	for(i = 0; i < n; i++){
+		s = &st[order[i]];
+		if(s->calls == 0)
+			continue;
+		kc = s->cycles >> 10;
+		if(order[i] < sizeof(syscallnames)/sizeof(syscallnames[0]) &&
+		   syscallnames[order[i]])
+			printf("%s:", syscallnames[order[i]]);
+		else
+			printf("syscall %d:", order[i]);
+		printf(" calls %d errors %d kcycles %d avg %d share %d%%\n",
+			s->calls, s->errors, kc, avg(s->cycles, s->calls),
+			total ? kc * 100 / total : 0);
+		printf("  hist");
+		for(b = 0; b < NSYSHIST; b++)
+			if(s->hist[b])
+				printf(" 2^%d:%d", b, s->hist[b]);
+		printf("\n");
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if(argc > 1 && strcmp(argv[1], "-r") == 0){
+		sysstat(SYSSTAT_RESET, 0, 0);
+		exit();
+	}
+	if(argc > 1){
+		sysstat(SYSSTAT_RESET, 0, 0);
+		if(fork() == 0){
+			exec(argv[1], argv + 1);
+			fprintf(2, "sysstat: exec %s failed\n", argv[1]);
+			exit();
+		}
+		wait();
+	}
+	print();
+	exit();
+}
@@ -0,0 +1,53 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/trace.h"
+#include "user.h"
+
+// Run a command with kernel event tracing on, then print the
+// events.  Capture the console and feed it to tools/trace2json
+// for a timeline:
+//
+//	$ trace usertests
+//
+// Each event is one line, "@ev cpu type pid a0 a1 tsc-high tsc-low";
+// the "@trace" line first gives the clock rate for converting the
+// TSC to time.  Rings hold the last NTRACE events of each CPU.
+
+#define NEV 64
+
+static struct traceev buf[NEV];
+
+int
+main(int argc, char *argv[])
+{
+	struct traceev *e;
+	int n, total;
+
+	if(argc < 2){
+		fprintf(2, "usage: trace cmd [args...]\n");
+		exit();
+	}
+	if(trace(TRACE_ON, 0, 0) < 0){
+		fprintf(2, "trace: cannot start tracing\n");
+		exit();
+	}
+	if(fork() == 0){
+		exec(argv[1], argv + 1);
+		fprintf(2, "trace: exec %s failed\n", argv[1]);
+		exit();
+	}
+	wait();
+	trace(TRACE_OFF, 0, 0);
+
+	printf("@trace hz %d tscpertick %d\n", HZ, tscpertick());
+	total = 0;
+	while((n = trace(TRACE_READ, buf, NEV)) > 0){
+		for(e = buf; e < buf + n; e++)
+			printf("@ev %d %d %d %x %d %x %x\n", e->cpu, e->type, e->pid,
+				e->a0, e->a1, (uint)(e->tsc >> 32), (uint)e->tsc);
+		total += n;
+	}
+	printf("@end %d events\n", total);
+	exit();
+}
@@ -4,6 +4,11 @@
 #include "user.h"
 #include "kernel/x86.h"
 #include "kernel/fs.h"
+#include "kernel/memlayout.h"
+#include "kernel/kinfo.h"
+
+#define KINFO ((struct kinfo*)VIRT_KINFO)
+#define PINFO ((struct pinfo*)VIRT_PINFO)
 
 char*
 strcpy(char *s, const char *t)
@@ -52,14 +57,25 @@ strcmp(const char *p, const char *q)
 	return (uchar)*p - (uchar)*q;
 }
 
+// A word has a zero byte iff HASZERO is nonzero.
+#define HASZERO(w) (((w) - 0x01010101) & ~(w) & 0x80808080)
+
 uint
 strlen(const char *s)
 {
-	int n;
+	const char *p;
+	const uint *w;
 
-	for(n = 0; s[n]; n++)
+	for(p = s; (uint)p % 4; p++)
+		if(*p == 0)
+			return p - s;
+	// An aligned word never straddles a page, so reading the
+	// bytes after the terminator in the same word is safe.
+	for(w = (const uint*)p; !HASZERO(*w); w++)
 		;
-	return n;
+	for(p = (const char*)w; *p; p++)
+		;
+	return p - s;
 }
 
 void*
@@ -121,19 +137,68 @@ atoi(const char *s)
 	return n;
 }
 
+// Below this many bytes a plain loop beats setting up rep movs.
+#define SHORTCOPY 16
+
+// Same as the kernel's: word copies once dst is aligned, and
+// downwards when dst overlaps the end of src.
 void*
 memmove(void *vdst, const void *vsrc, int n)
 {
 	char *dst;
 	const char *src;
+	int k;
 
 	dst = vdst;
 	src = vsrc;
-	while(n-- > 0)
-		*dst++ = *src++;
+	if(src < dst && src + n > dst){
+		src += n;
+		dst += n;
+		if(n >= SHORTCOPY){
+			for(k = (uint)dst % 4; k > 0; k--, n--)
+				*--dst = *--src;
+			k = n / 4;
+			rmovsl(dst - 4, src - 4, k);
+			dst -= k * 4;
+			src -= k * 4;
+			n %= 4;
+		}
+		while(n-- > 0)
+			*--dst = *--src;
+	} else {
+		if(n >= SHORTCOPY){
+			for(k = -(uint)dst % 4; k > 0; k--, n--)
+				*dst++ = *src++;
+			k = n / 4;
+			movsl(dst, src, k);
+			dst += k * 4;
+			src += k * 4;
+			n %= 4;
+		}
+		while(n-- > 0)
+			*dst++ = *src++;
+	}
 	return vdst;
 }
 
+int
+memcmp(const void *v1, const void *v2, uint n)
+{
+	const uchar *s1, *s2;
+
+	s1 = v1;
+	s2 = v2;
+	// Skip equal words; x86 does not mind unaligned loads.
+	while(n >= 4 && *(uint*)s1 == *(uint*)s2)
+		s1 += 4, s2 += 4, n -= 4;
+	while(n-- > 0){
+		if(*s1 != *s2)
+			return *s1 - *s2;
+		s1++, s2++;
+	}
+	return 0;
+}
+
 int get_symlink_data(char* path, char* destination, int passed_file_descriptor){
     // this function will copy the data stored in the inode of the symlink to the destinaion buffer
     //char buffer[DIRSIZ];
@@ -164,4 +229,39 @@ int get_symlink_data(char* path, char* destination, int passed_file_descriptor){
         return 1;
     }
     
-}
\ No newline at end of file
+}
+
+// These read the kernel info pages instead of making a system call.
+
+// Timer ticks since boot.
+int
+uptime(void)
+{
+	return KINFO->ticks;
+}
+
+int
+getpid(void)
+{
+	return PINFO->pid;
+}
+
+// TSC cycles since boot; monotonic, and much finer than uptime().
+// tscpertick() converts.
+uint64
+tscclock(void)
+{
+	return rdtsc() - KINFO->tscboot;
+}
+
+uint
+tscpertick(void)
+{
+	return KINFO->tscpertick;
+}
+
+int
+cpucount(void)
+{
+	return KINFO->ncpu;
+}
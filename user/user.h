@@ -3,6 +3,13 @@
 
 struct stat;
 struct rtcdate;
+struct pollfd;
+struct aio_ring;
+struct memstat;
+struct traceev;
+struct profsample;
+struct sysstat;
+struct procmem;
 
 // system calls
 int fork(void);
@@ -22,10 +29,8 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
 int getcwd(void*, int);
 // takes path as char argument
 int symlink(char*, char*);
@@ -34,6 +39,24 @@ int shm_open(char* /*name*/);
 int shm_trunc(int /*shm_od*/, int /*size*/);
 int shm_map(int /*shm_od*/, void ** /*va*/, int /*flags*/);
 int shm_close(int /*shm_od*/);
+// moves up to n bytes between a pipe and another fd in the kernel
+int splice(int /*fd_in*/, int /*fd_out*/, int /*n*/);
+// waits for events on several fds; timeout in ticks, -1 forever
+int poll(struct pollfd*, int /*nfds*/, int /*timeout*/);
+int fcntl(int /*fd*/, int /*cmd*/, int /*arg*/);
+struct aio_ring* aio_setup(void);
+int aio_enter(int /*min_complete*/);
+int futex(uint* /*addr*/, int /*op*/, int /*val*/);
+// fills in ms and up to n entries of pm; returns the number of processes
+int memstat(struct memstat* /*ms*/, struct procmem* /*pm*/, int /*n*/);
+// sleeps sec seconds plus nsec nanoseconds, 0 <= nsec < 10^9
+int nanosleep(int /*sec*/, int /*nsec*/);
+// TRACE_ON, TRACE_OFF, or TRACE_READ up to n events into buf
+int trace(int /*cmd*/, struct traceev* /*buf*/, int /*n*/);
+// PROF_START, PROF_STOP, or PROF_READ up to n samples into buf
+int prof(int /*cmd*/, struct profsample* /*buf*/, int /*n*/);
+// SYSSTAT_READ into up to n entries of buf, or SYSSTAT_RESET
+int sysstat(int /*cmd*/, struct sysstat* /*buf*/, int /*n*/);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -41,6 +64,7 @@ char* strcpy(char*, const char*);
 char* strncpy(char*, const char*, int);
 char* safestrcpy(char*, const char*, int);
 void *memmove(void*, const void*, int);
+int memcmp(const void*, const void*, uint);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...);
@@ -52,6 +76,12 @@ void* malloc(uint);
 void free(void*);
 int atoi(const char*);
 int get_symlink_data(char* path, char* destination, int passed_file_descriptor);
+// from the kernel info pages, without a system call
+int getpid(void);
+int uptime(void);
+uint64 tscclock(void);
+uint tscpertick(void);
+int cpucount(void);
 
 
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "kernel/syscall.h"
 #include "kernel/traps.h"
 #include "kernel/memlayout.h"
+#include "kernel/aio.h"
 
 char buf[8192];
 char name[3];
@@ -354,6 +355,161 @@ pipe1(void)
 	printf("pipe1 ok\n");
 }
 
+// splice() a file into a pipe and the pipe back out to
+// another file, and check the copy matches.
+void
+splicetest(void)
+{
+	int fds[2], fd, pid, i, n, total;
+
+	printf("splice test\n");
+	fd = open("splicein", O_CREATE|O_RDWR);
+	if(fd < 0){
+		printf("splice: create failed\n");
+		exit();
+	}
+	for(i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7;
+	for(i = 0; i < 2; i++){
+		if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+			printf("splice: write failed\n");
+			exit();
+		}
+	}
+	close(fd);
+
+	if(pipe(fds) != 0){
+		printf("pipe() failed\n");
+		exit();
+	}
+	pid = fork();
+	if(pid < 0){
+		printf("fork() failed\n");
+		exit();
+	}
+	if(pid == 0){
+		close(fds[0]);
+		fd = open("splicein", O_RDONLY);
+		if(splice(fd, fds[1], 2*sizeof(buf)) != 2*sizeof(buf)){
+			printf("splice: file to pipe failed\n");
+			exit();
+		}
+		close(fd);
+		close(fds[1]);
+		exit();
+	}
+	close(fds[1]);
+	fd = open("spliceout", O_CREATE|O_RDWR);
+	total = 0;
+	while((n = splice(fds[0], fd, 2*sizeof(buf))) > 0)
+		total += n;
+	close(fds[0]);
+	close(fd);
+	wait();
+	if(total != 2*sizeof(buf)){
+		printf("splice: moved %d bytes\n", total);
+		exit();
+	}
+
+	fd = open("spliceout", O_RDONLY);
+	for(total = 0; (n = read(fd, buf, sizeof(buf))) > 0; total += n){
+		for(i = 0; i < n; i++){
+			if((buf[i] & 0xff) != (((total + i) * 7) & 0xff)){
+				printf("splice: wrong data\n");
+				exit();
+			}
+		}
+	}
+	close(fd);
+	unlink("splicein");
+	unlink("spliceout");
+	printf("splice test ok\n");
+}
+
+// queue one request on the aio submission ring
+static void
+aioqueue(struct aio_ring *r, int op, int fd, void *addr, int n)
+{
+	struct aio_sqe *sqe;
+
+	sqe = &r->sq[r->sq_tail & (AIO_SQSIZE-1)];
+	sqe->op = op;
+	sqe->fd = fd;
+	sqe->addr = (uint)addr;
+	sqe->n = n;
+	sqe->user_data = r->sq_tail;
+	r->sq_tail++;
+}
+
+void
+aiotest(void)
+{
+	struct aio_ring *r;
+	struct aio_cqe *cqe;
+	int fd, i, n, pid;
+
+	printf("aio test\n");
+	r = aio_setup();
+	if(r == (struct aio_ring*)-1){
+		printf("aio: setup failed\n");
+		exit();
+	}
+	if(aio_setup() != (struct aio_ring*)-1){
+		printf("aio: second setup succeeded\n");
+		exit();
+	}
+
+	aioqueue(r, AIO_OPEN, 0, "aiofile", O_CREATE|O_RDWR);
+	if(aio_enter(1) != 1 || (fd = r->cq[r->cq_head & (AIO_CQSIZE-1)].res) < 0){
+		printf("aio: open failed\n");
+		exit();
+	}
+	r->cq_head++;
+
+	// one batch: four writes, fsync, close
+	for(i = 0; i < 4*512; i++)
+		buf[i] = i * 3;
+	for(i = 0; i < 4; i++)
+		aioqueue(r, AIO_WRITE, fd, buf + i*512, 512);
+	aioqueue(r, AIO_FSYNC, fd, 0, 0);
+	aioqueue(r, AIO_CLOSE, fd, 0, 0);
+	if((n = aio_enter(6)) != 6){
+		printf("aio: %d completions\n", n);
+		exit();
+	}
+	for(i = 0; i < 6; i++, r->cq_head++){
+		cqe = &r->cq[r->cq_head & (AIO_CQSIZE-1)];
+		if(cqe->user_data != r->cq_head || cqe->res != (i < 4 ? 512 : 0)){
+			printf("aio: request %d returned %d\n", cqe->user_data, cqe->res);
+			exit();
+		}
+	}
+
+	fd = open("aiofile", O_RDONLY);
+	if(fd < 0 || read(fd, buf + 4096, 4*512) != 4*512){
+		printf("aio: read back failed\n");
+		exit();
+	}
+	close(fd);
+	for(i = 0; i < 4*512; i++){
+		if(buf[4096 + i] != buf[i]){
+			printf("aio: wrong data\n");
+			exit();
+		}
+	}
+
+	// the rings are not inherited
+	pid = fork();
+	if(pid == 0){
+		if(aio_enter(0) >= 0)
+			printf("aio: child inherited rings\n");
+		exit();
+	}
+	wait();
+	unlink("aiofile");
+	printf("aio test ok\n");
+}
+
 // meant to be run w/ at most two CPUs
 void
 preempt(void)
@@ -1347,7 +1503,7 @@ iref(void)
 
 	printf("empty file name\n");
 
-	// the 50 is NINODE
+	// the 50 was the old fixed size of the inode cache
 	for(i = 0; i < 50 + 1; i++){
 		if(mkdir("irefd") != 0){
 			printf("mkdir irefd failed\n");
@@ -1383,7 +1539,8 @@ forktest(void)
 
 	printf("fork test\n");
 
-	for(n=0; n<1000; n++){
+	// fork is only limited by memory, so go until it runs out
+	for(n=0; n<10000; n++){
 		pid = fork();
 		if(pid < 0)
 			break;
@@ -1391,8 +1548,8 @@ forktest(void)
 			exit();
 	}
 
-	if(n == 1000){
-		printf("fork claimed to work 1000 times!\n");
+	if(n == 10000){
+		printf("fork claimed to work 10000 times!\n");
 		exit();
 	}
 
@@ -1781,6 +1938,8 @@ main(int argc, char *argv[])
 
 	mem();
 	pipe1();
+	splicetest();
+	aiotest();
 	preempt();
 	exitwait();
 